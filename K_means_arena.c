@@ -0,0 +1,317 @@
+// Same K-Means as K_means_para.c but every buffer comes out of one arena: one big 64 byte aligned mapping, backed by huge pages when the system has them,
+// that the points, the labels and the per thread partial sums are carved out of. Instead of a million small mallocs for the points (each with its
+// own header, scattered over the heap, one TLB entry per 4KB page) the points are one contiguous block on 2MB pages, and instead of the million free()
+// calls at the end the whole thing goes back with a single munmap.
+// The program does NUM_RUNS restarts (each one starting from a different K points) and keeps the one with the lowest SSE. Between restarts the
+// arena is reset to the mark just after the points, so the labels and partial sums of the next run reuse the same memory instead of being freed and
+// allocated again.
+// usage: ./K_means_arena [malloc]
+//      malloc -> allocate everything the old way (per point malloc, calloc / free per run) for comparison
+
+#define _GNU_SOURCE     // for MAP_HUGETLB / MADV_HUGEPAGE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define NUM_RUNS 5          // restarts, run r starts from points r * K ... r * K + K - 1
+#define HUGE_PAGE_SIZE (2UL * 1024 * 1024)
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// every thread's sums in their own cache lines, same as K_means_persistent.c
+struct partial_sums {
+    double sums[K][DIM];
+    int counts[K];
+    int changed;
+    char pad[64];
+};
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The arena. A bump allocator over one mapping: arena_alloc hands out the next 64 byte aligned piece, arena_reset(mark) gives back everything
+// allocated after mark, and arena_destroy returns the whole mapping at once.
+// the mapping is first tried with MAP_HUGETLB (explicit huge pages, only works if some are reserved in /proc/sys/vm/nr_hugepages), and otherwise
+// made with normal pages plus madvise(MADV_HUGEPAGE), which asks for transparent huge pages.
+
+struct arena {
+    char *base;
+    size_t size;
+    size_t used;
+    const char *backing;    // what we ended up with, for the output
+};
+
+static int arena_create(struct arena *a, size_t size) {
+    size = (size + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    a->size = size;
+    a->used = 0;
+    a->backing = "MAP_HUGETLB";
+    a->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (a->base == MAP_FAILED) {
+        a->backing = "transparent huge pages (madvise)";
+        a->base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (a->base == MAP_FAILED) {
+            perror("arena: mmap");
+            return -1;
+        }
+        if (madvise(a->base, size, MADV_HUGEPAGE) != 0) {
+            a->backing = "normal pages";    // no THP in this kernel, still one contiguous block
+        }
+    }
+    return 0;
+}
+
+static void *arena_alloc(struct arena *a, size_t bytes) {
+    size_t start = (a->used + 63) & ~(size_t)63;
+    if (start + bytes > a->size) {
+        fprintf(stderr, "arena: out of space (%zu of %zu bytes used, %zu more asked for)\n", a->used, a->size, bytes);
+        exit(1);
+    }
+    a->used = start + bytes;
+    return a->base + start;
+}
+
+static size_t arena_mark(const struct arena *a) {
+    return a->used;
+}
+
+static void arena_reset(struct arena *a, size_t mark) {
+    a->used = mark;
+}
+
+static void arena_destroy(struct arena *a) {
+    munmap(a->base, a->size);
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// One K-Means run (the loop of K_means_persistent.c's partial sums with K_means_para.c's parallel for), returns the number of iterations and the SSE.
+
+static int kmeans_run(double **data, int first, double centroids[K][DIM], label_t *labels, struct partial_sums *partials, int num_partials, double *sse) {
+    int iter;
+    int changed = 1;
+    for (int c = 0; c < K; c++) {
+        for (int d = 0; d < DIM; d++) {
+            centroids[c][d] = data[first + c][d];
+        }
+    }
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        // all the slots are cleared, not just the ones of this team: the team can come out smaller than num_partials (dynamic threads, a thread
+        // limit, nesting) and the unused slots would still hold the sums of the last iteration / run. only the team's slots get merged below
+        memset(partials, 0, num_partials * sizeof(struct partial_sums));
+        int team_size = 1;
+        #pragma omp parallel
+        {
+            struct partial_sums *mine = &partials[omp_get_thread_num()];
+            #pragma omp single nowait
+            team_size = omp_get_num_threads();
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int best_cluster = 0;
+                double best_dist = distance_sq(data[i], centroids[0]);
+                for (int j = 1; j < K; j++) {
+                    double d = distance_sq(data[i], centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    mine->changed = 1;
+                }
+                mine->counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    mine->sums[best_cluster][d] += data[i][d];
+                }
+            }
+        }
+
+        // merged in thread order after the region instead of in a critical section, the partials are already where we can see them
+        double new_centroids[K][DIM] = {{0}};
+        int counts[K] = {0};
+        for (int t = 0; t < team_size; t++) {
+            changed |= partials[t].changed;
+            for (int c = 0; c < K; c++) {
+                counts[c] += partials[t].counts[c];
+                for (int d = 0; d < DIM; d++) {
+                    new_centroids[c][d] += partials[t].sums[c][d];
+                }
+            }
+        }
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+
+    double total = 0.0;
+    #pragma omp parallel for reduction(+:total)
+    for (int i = 0; i < NUM_POINTS; i++) {
+        total += distance_sq(data[i], centroids[labels[i]]);
+    }
+    *sse = total;
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+    int use_malloc = argc > 1 && strcmp(argv[1], "malloc") == 0;
+    int num_threads = omp_get_max_threads();
+
+// ===================================================================================================================================
+// Allocating/creating the data. with the arena the points are one block with the usual double **data index on top, both from the arena
+
+    double setup_start = omp_get_wtime();
+    struct arena arena;
+    double **data;
+    size_t run_mark = 0;
+
+    if (use_malloc) {
+        data = malloc(NUM_POINTS * sizeof(double *));
+        for (i = 0; i < NUM_POINTS; i++) {
+            data[i] = malloc(DIM * sizeof(double));
+        }
+    } else {
+        size_t bytes = (size_t)NUM_POINTS * DIM * sizeof(double) + NUM_POINTS * sizeof(double *)    // points and index
+                     + NUM_POINTS * sizeof(label_t) + num_threads * sizeof(struct partial_sums)      // one run's labels and partials
+                     + 4 * 64;                                                                       // alignment
+        if (arena_create(&arena, bytes) != 0) return 1;
+        double *storage = arena_alloc(&arena, (size_t)NUM_POINTS * DIM * sizeof(double));
+        data = arena_alloc(&arena, NUM_POINTS * sizeof(double *));
+        for (i = 0; i < NUM_POINTS; i++) {
+            data[i] = &storage[(size_t)i * DIM];
+        }
+        run_mark = arena_mark(&arena);      // everything after this belongs to a single run
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+    double setup_time = omp_get_wtime() - setup_start;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The restarts
+
+    double best_centroids[K][DIM];
+    double best_sse = 0.0;
+    int best_run = -1, best_iterations = 0;
+
+    double start_time = omp_get_wtime();
+    for (int run = 0; run < NUM_RUNS; run++) {
+        label_t *labels;
+        struct partial_sums *partials;
+        if (use_malloc) {
+            labels = calloc(NUM_POINTS, sizeof(label_t));
+            partials = malloc(num_threads * sizeof(struct partial_sums));
+        } else {
+            arena_reset(&arena, run_mark);
+            labels = arena_alloc(&arena, NUM_POINTS * sizeof(label_t));
+            partials = arena_alloc(&arena, num_threads * sizeof(struct partial_sums));
+            memset(labels, 0, NUM_POINTS * sizeof(label_t));
+        }
+
+        double centroids[K][DIM];
+        double sse;
+        int iterations = kmeans_run(data, run * K, centroids, labels, partials, num_threads, &sse);
+        if (best_run < 0 || sse < best_sse) {
+            best_sse = sse;
+            best_run = run;
+            best_iterations = iterations;
+            memcpy(best_centroids, centroids, sizeof(centroids));
+        }
+
+        if (use_malloc) {
+            free(labels);
+            free(partials);
+        }
+    }
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("Memory: %s\n", use_malloc ? "malloc per point" : arena.backing);
+    printf("Setup time (allocation + data): %f seconds\n", setup_time);
+    printf("Elapsed time (%d runs): %f seconds\n", NUM_RUNS, elapsed);
+    printf("Best run: %d (converged in %d iterations, SSE %f)\n", best_run, best_iterations, best_sse);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", best_centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory. with the arena this is one munmap, no loop over the points
+    double free_start = omp_get_wtime();
+    if (use_malloc) {
+        for (i = 0; i < NUM_POINTS; i++) {
+            free(data[i]);
+        }
+        free(data);
+    } else {
+        arena_destroy(&arena);
+    }
+    printf("Teardown time: %f seconds\n", omp_get_wtime() - free_start);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,346 @@
+// Same code as the K_means_para.c file will be used here but instead of hand picking the schedule like K_means_static.c (static, 500000) and K_means_dynamic.c (dynamic, 10000)
+// the program picks it by itself. The first iterations of the run double as the benchmark: a handful of schedule / chunk size / thread count candidates
+// get timed on real iterations, the fastest one gets locked in for the rest of the run and saved to a tuning cache file. The cache is keyed by
+// NUM_POINTS, DIM, K and the number of cores, so the next run on the same machine with the same sizes starts with the tuned settings right away.
+// usage: ./K_means_autotune [retune]
+//      retune -> ignore the cache and tune again
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define TUNING_CACHE "kmeans_tuning.cache"     // one line per tuned configuration, in the current directory
+#define ROUNDS 2            // every candidate gets timed once per round, so ROUNDS iterations each
+#define WARMUP_ITERS 3      // iterations run with the default configuration before any timing: the first few are a lot slower than the rest
+                            // (cold caches, most of the labels changing), which would count against whichever candidate got them
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The configurations we try. Both parallel loops use schedule(runtime), so omp_set_schedule decides what they actually do.
+// chunk 0 means "let OpenMP pick" (for static that is one equal block per thread, like K_means_para.c).
+// Only a few candidates, every iteration spent on a slow one is an iteration of the real run: the schedules that have a chance with the same work per
+// point (one block per thread, small static blocks, dynamic with big enough chunks, guided), all with every core, plus static with half the cores.
+//
+// Iterations don't all cost the same: the later ones write fewer labels and mispredict fewer branches, so simply timing candidate after candidate
+// makes the last ones look faster. The candidates are timed in ROUNDS rounds, every other round in reverse order, so a candidate that runs late in
+// one round runs early in the next and a steady trend cancels out. And a change of thread count makes the first iteration on the new team slower
+// (threads starting up, cold caches), so that iteration is run but not counted.
+
+struct tuning_config {
+    omp_sched_t kind;
+    int chunk;
+    int threads;
+};
+
+// one iteration of the tuning plan
+struct tuning_step {
+    int candidate;
+    int timed;              // 0 = the warm up iteration after a thread count change
+};
+
+static const char *kind_name(omp_sched_t kind) {
+    switch (kind) {
+        case omp_sched_static: return "static";
+        case omp_sched_dynamic: return "dynamic";
+        case omp_sched_guided: return "guided";
+        default: return "auto";
+    }
+}
+
+static int build_candidates(struct tuning_config *out, int cores) {
+    const struct tuning_config schedules[] = {
+        {omp_sched_static, 0, 0},
+        {omp_sched_static, 10000, 0},
+        {omp_sched_dynamic, 10000, 0},
+        {omp_sched_guided, 0, 0},
+    };
+    int n = 0;
+    for (int s = 0; s < (int)(sizeof(schedules) / sizeof(schedules[0])); s++) {
+        out[n] = schedules[s];
+        out[n].threads = cores;
+        n++;
+    }
+    if (cores / 2 >= 1 && cores / 2 != cores) {
+        out[n].kind = omp_sched_static;
+        out[n].chunk = 0;
+        out[n].threads = cores / 2;
+        n++;
+    }
+    return n;
+}
+
+// the order the candidates get run in, with a warm up step in front of every thread count change. returns the number of steps
+static int build_plan(struct tuning_step *plan, const struct tuning_config *candidates, int num_candidates, int start_threads) {
+    int n = 0;
+    int threads = start_threads;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int c = 0; c < num_candidates; c++) {
+            int candidate = round % 2 == 0 ? c : num_candidates - 1 - c;
+            if (candidates[candidate].threads != threads) {
+                plan[n].candidate = candidate;
+                plan[n].timed = 0;
+                n++;
+                threads = candidates[candidate].threads;
+            }
+            plan[n].candidate = candidate;
+            plan[n].timed = 1;
+            n++;
+        }
+    }
+    return n;
+}
+
+// cache line format: num_points dim k cores kind chunk threads
+static int load_tuning(struct tuning_config *config, int cores) {
+    FILE *f = fopen(TUNING_CACHE, "r");
+    if (f == NULL) return 0;
+    int n, dim, k, c, kind, chunk, threads;
+    int found = 0;
+    while (fscanf(f, "%d %d %d %d %d %d %d", &n, &dim, &k, &c, &kind, &chunk, &threads) == 7) {
+        if (n == NUM_POINTS && dim == DIM && k == K && c == cores) {
+            config->kind = (omp_sched_t)kind;
+            config->chunk = chunk;
+            config->threads = threads;
+            found = 1;      // keep reading, the last matching line is the newest one
+        }
+    }
+    fclose(f);
+    return found;
+}
+
+static void save_tuning(const struct tuning_config *config, int cores) {
+    FILE *f = fopen(TUNING_CACHE, "a");
+    if (f == NULL) {
+        perror("autotune: " TUNING_CACHE);
+        return;
+    }
+    fprintf(f, "%d %d %d %d %d %d %d\n", NUM_POINTS, DIM, K, cores, (int)config->kind, config->chunk, config->threads);
+    fclose(f);
+}
+
+static void apply_config(const struct tuning_config *config) {
+    omp_set_schedule(config->kind, config->chunk);
+    omp_set_num_threads(config->threads);
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j, iter;
+    int retune = argc > 1 && strcmp(argv[1], "retune") == 0;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Picking the configuration: from the cache if we have one, otherwise the first WARMUP_ITERS iterations are a warm up and the iterations
+// after them follow the tuning plan.
+
+    int cores = omp_get_num_procs();
+    struct tuning_config candidates[5];
+    int num_candidates = build_candidates(candidates, cores);
+    struct tuning_step plan[ROUNDS * 2 * 5];
+    int plan_length = build_plan(plan, candidates, num_candidates, cores);
+    double candidate_time[5] = {0};
+    int candidate_runs[5] = {0};
+
+    struct tuning_config best = {omp_sched_static, 0, cores};
+    int tuning = retune || !load_tuning(&best, cores);
+    apply_config(&best);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop, same as K_means_para.c except for schedule(runtime) and the timing of each iteration while tuning
+
+    double start_time = omp_get_wtime();
+
+    int changed = 1;
+    int steps_done = 0;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        int trying = tuning && iter >= WARMUP_ITERS && iter - WARMUP_ITERS < plan_length;
+        const struct tuning_step *step = trying ? &plan[iter - WARMUP_ITERS] : NULL;
+        if (trying) {
+            apply_config(&candidates[step->candidate]);
+        }
+        double iter_start = omp_get_wtime();
+
+        changed = 0;
+        #pragma omp parallel for private(j) reduction(|:changed) schedule(runtime)
+        for (i = 0; i < NUM_POINTS; i++) {
+            int best_cluster = 0;
+            double best_dist = distance_sq(data[i], centroids[0]);
+            for (j = 1; j < K; j++) {
+                double d = distance_sq(data[i], centroids[j]);
+                if (d < best_dist) {
+                    best_dist = d;
+                    best_cluster = j;
+                }
+            }
+            if (labels[i] != best_cluster) {
+                labels[i] = (label_t)best_cluster;
+                changed |= 1;
+            }
+        }
+
+        double new_centroids[K][DIM] = {0};
+        int counts[K] = {0};
+
+        // same partial sum technique as K_means_para.c
+        #pragma omp parallel
+        {
+            double local_new_centroids[K][DIM] = {0};
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait schedule(runtime)
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int cluster = labels[i];
+                local_counts[cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[cluster][d] += data[i][d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        if (trying) {
+            if (step->timed) {
+                candidate_time[step->candidate] += omp_get_wtime() - iter_start;
+                candidate_runs[step->candidate]++;
+            }
+            steps_done++;
+            // either the plan is done, or this was the last iteration we will get: lock in the fastest one so far (by average time per iteration)
+            if (steps_done == plan_length || !changed) {
+                int fastest = -1;
+                for (int c = 0; c < num_candidates; c++) {
+                    if (candidate_runs[c] == 0) continue;
+                    if (fastest < 0 || candidate_time[c] / candidate_runs[c] < candidate_time[fastest] / candidate_runs[fastest]) fastest = c;
+                }
+                if (fastest >= 0) best = candidates[fastest];
+                apply_config(&best);
+                // only a complete tuning gets cached, otherwise the next run tries again
+                if (steps_done == plan_length) save_tuning(&best, cores);
+            }
+        }
+
+        for (i = 0; i < K; i++) {
+            if (counts[i] > 0) {
+                for (j = 0; j < DIM; j++) {
+                    centroids[i][j] = new_centroids[i][j] / counts[i];
+                }
+            }
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations.\n", iter);
+    printf("Elapsed time (autotuned): %f seconds\n", elapsed);
+    if (tuning) {
+        printf("Tuned over %d of %d planned iterations:\n", steps_done, plan_length);
+        for (int c = 0; c < num_candidates; c++) {
+            if (candidate_runs[c] == 0) continue;
+            printf("    %-8s chunk %-7d threads %-3d %f seconds per iteration (%d timed)\n", kind_name(candidates[c].kind), candidates[c].chunk,
+                   candidates[c].threads, candidate_time[c] / candidate_runs[c], candidate_runs[c]);
+        }
+    } else {
+        printf("Using cached configuration from %s\n", TUNING_CACHE);
+    }
+    printf("Schedule: %s, chunk %d, %d threads\n", kind_name(best.kind), best.chunk, best.threads);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
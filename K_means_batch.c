@@ -0,0 +1,215 @@
+// Batched K-Means: lots of small independent clustering jobs (one per tenant, 10k - 100k points each) instead of one big one.
+// With a job this small, splitting its points over threads with #pragma omp parallel for is mostly fork/join overhead, so in batch mode every job runs
+// start to finish on ONE thread and the parallelism comes from running many jobs at the same time. The jobs have different sizes, so they are handed out
+// one at a time (schedule(dynamic, 1)) biggest first: whoever finishes early just grabs the next job, which keeps all threads busy until the end.
+// All label and centroid buffers come out of one arena allocated up front, so there is no malloc / free per job.
+// The program runs the same jobs both ways and prints jobs/second for each.
+// usage: ./K_means_batch [num_jobs]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+#define DEFAULT_JOBS 256     // number of independent datasets
+#define MIN_POINTS 10000     // smallest dataset
+#define MAX_POINTS 100000    // biggest dataset
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// A job is a slice of the big data / labels / centroids arrays.
+
+struct job {
+    int num_points;
+    long first;             // index of its first point in the shared data and labels arrays
+    int iterations;         // filled in by the run
+};
+
+// K-Means on one job. parallel = 0 is the batch mode (whole job on the calling thread), parallel = 1 splits the points of this one job over
+// the threads like K_means_para.c does
+static int kmeans_job(const double *points, int n, label_t *labels, double centroids[K][DIM], int parallel) {
+    int iter;
+    int changed = 1;
+    memset(labels, 0, n * sizeof(label_t));
+    for (int c = 0; c < K; c++) {
+        for (int d = 0; d < DIM; d++) {
+            centroids[c][d] = points[c * DIM + d];
+        }
+    }
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {{0}};
+        int counts[K] = {0};
+
+        #pragma omp parallel if(parallel) reduction(|:changed)
+        {
+            double local_new_centroids[K][DIM] = {{0}};
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < n; i++) {
+                double *point = (double *)&points[(size_t)i * DIM];
+                int best_cluster = 0;
+                double best_dist = distance_sq(point, centroids[0]);
+                for (int j = 1; j < K; j++) {
+                    double d = distance_sq(point, centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed |= 1;
+                }
+                local_counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[best_cluster][d] += point[d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    return iter;
+}
+
+// biggest job first for the dynamic schedule
+static int compare_jobs(const void *a, const void *b) {
+    const struct job *ja = a, *jb = b;
+    return jb->num_points - ja->num_points;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i;
+    int num_jobs = argc > 1 ? atoi(argv[1]) : DEFAULT_JOBS;
+    if (num_jobs < 1) num_jobs = 1;
+
+// ===================================================================================================================================
+// Creating the jobs. All the datasets are stored back to back in one flat array, the labels and centroids of every job live in one arena.
+
+    struct job *jobs = malloc(num_jobs * sizeof(struct job));
+    long total_points = 0;
+    for (i = 0; i < num_jobs; i++) {
+        jobs[i].num_points = MIN_POINTS + rand() % (MAX_POINTS - MIN_POINTS + 1);
+        jobs[i].first = total_points;
+        total_points += jobs[i].num_points;
+    }
+
+    double *data = malloc((size_t)total_points * DIM * sizeof(double));
+    for (long p = 0; p < total_points * DIM; p++) {
+        data[p] = (double)rand() / RAND_MAX;
+    }
+
+    // the arena: every job's labels, then every job's centroids. one allocation, carved up by offset, reused by both runs below
+    size_t labels_bytes = (size_t)total_points * sizeof(label_t);
+    labels_bytes = (labels_bytes + 63) & ~(size_t)63;       // keep the centroids 64 byte aligned
+    size_t arena_bytes = labels_bytes + (size_t)num_jobs * K * DIM * sizeof(double);
+    arena_bytes = (arena_bytes + 63) & ~(size_t)63;         // aligned_alloc wants a multiple of the alignment
+    char *arena = aligned_alloc(64, arena_bytes);
+    if (arena == NULL) {
+        perror("batch: aligned_alloc");
+        return 1;
+    }
+    label_t *all_labels = (label_t *)arena;
+    double (*all_centroids)[K][DIM] = (double (*)[K][DIM])(arena + labels_bytes);
+
+    qsort(jobs, num_jobs, sizeof(struct job), compare_jobs);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Run 1: every job on its own thread. Run 2: one job after the other, each split over all threads (what you'd get calling K_means_para.c per job).
+
+    double batch_start = omp_get_wtime();
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int j = 0; j < num_jobs; j++) {
+        jobs[j].iterations = kmeans_job(&data[jobs[j].first * DIM], jobs[j].num_points, &all_labels[jobs[j].first], all_centroids[j], 0);
+    }
+    double batch_time = omp_get_wtime() - batch_start;
+
+    long batch_iterations = 0;
+    for (i = 0; i < num_jobs; i++) {
+        batch_iterations += jobs[i].iterations;
+    }
+    double first_job_centroid = all_centroids[0][0][0];
+
+    double split_start = omp_get_wtime();
+    for (int j = 0; j < num_jobs; j++) {
+        jobs[j].iterations = kmeans_job(&data[jobs[j].first * DIM], jobs[j].num_points, &all_labels[jobs[j].first], all_centroids[j], 1);
+    }
+    double split_time = omp_get_wtime() - split_start;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("%d jobs, %ld points in total, %d threads\n", num_jobs, total_points, omp_get_max_threads());
+    printf("Batch mode (one job per thread):     %f seconds, %.1f jobs/sec, %ld iterations\n", batch_time, num_jobs / batch_time, batch_iterations);
+    printf("Per job parallel for (like para.c):  %f seconds, %.1f jobs/sec\n", split_time, num_jobs / split_time);
+    printf("Biggest job (%d points), first centroid: %f (batch) %f (per job)\n", jobs[0].num_points, first_job_centroid, all_centroids[0][0][0]);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory. the whole arena goes in one free
+    free(arena);
+    free(data);
+    free(jobs);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,414 @@
+// Same code as the K_means_para.c file will be used here but i will add checkpointing so that a long run that gets killed can be resumed from where it stopped
+// usage: ./K_means_checkpoint <checkpoint_file> [resume] [labels]
+//      resume -> load the checkpoint file and continue from the saved iteration
+//      labels -> also store the labels array in the checkpoint (bigger file but the first resumed iteration doesn't have to treat every point as "changed")
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define SEED 1                  // seed for rand(), saved in the checkpoint so a resumed run regenerates the exact same data
+#define CHECKPOINT_EVERY 10     // write a checkpoint every this many iterations
+#define CHECKPOINT_MAGIC 0x4B4D434BU   // "KMCK"
+#define CHECKPOINT_VERSION 1
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Checkpoint file layout (everything is written raw, in the byte order of the machine that wrote it):
+//      header  (struct checkpoint_header below)
+//      centroids   K * DIM doubles
+//      labels      NUM_POINTS label_t values, only if header.has_labels is 1
+// the sizes are in the header so we can refuse a checkpoint that came from a build with different NUM_POINTS / DIM / K
+
+struct checkpoint_header {
+    unsigned int magic;
+    unsigned int version;
+    int num_points;
+    int dim;
+    int k;
+    int label_bytes;
+    int iter;           // number of iterations already completed
+    int changed;        // value of the convergence flag after the last completed iteration
+    unsigned int seed;  // the rng state: the data is fully determined by the srand() seed
+    int has_labels;
+};
+
+// The writing is done by a separate thread so the iteration loop never waits for the disk.
+// the main thread copies the state into the snapshot buffers (a memcpy of a few MB at most) and signals the writer, the writer does the slow fwrite/rename part.
+// if the writer is still busy with the previous checkpoint when the next one is due, we just skip that one instead of stalling.
+struct checkpoint_writer {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    const char *path;
+    int pending;        // 1 when a snapshot is waiting to be written (or is being written)
+    int quit;
+    int written;        // checkpoints that actually made it to disk
+    int failed;         // and the ones that didn't
+    int last_ok;        // whether the most recent write succeeded
+    struct checkpoint_header header;
+    double centroids[K][DIM];
+    label_t *labels;    // NULL if we are not saving labels
+};
+
+static int write_checkpoint_file(const char *path, const struct checkpoint_header *h, double centroids[K][DIM], const label_t *labels) {
+    // write to a temporary file first and then rename it, that way a crash in the middle of a write never destroys the last good checkpoint.
+    // the data is fsync'ed before the rename and the directory after it, otherwise after a power loss the rename can be on disk without the data
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *f = fopen(tmp_path, "wb");
+    if (f == NULL) {
+        perror("checkpoint: fopen");
+        return -1;
+    }
+    int ok = fwrite(h, sizeof(*h), 1, f) == 1;
+    ok = ok && fwrite(centroids, sizeof(double), K * DIM, f) == K * DIM;
+    if (h->has_labels) {
+        ok = ok && fwrite(labels, sizeof(label_t), NUM_POINTS, f) == NUM_POINTS;
+    }
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        perror("checkpoint: write");
+        remove(tmp_path);
+        return -1;
+    }
+
+    // the rename itself lives in the directory, so that gets synced too
+    char dir_path[4096];
+    snprintf(dir_path, sizeof(dir_path), "%s", path);
+    char *slash = strrchr(dir_path, '/');
+    if (slash == NULL) {
+        strcpy(dir_path, ".");
+    } else if (slash == dir_path) {
+        slash[1] = '\0';     // a file in /
+    } else {
+        *slash = '\0';
+    }
+    int dir_fd = open(dir_path, O_RDONLY);
+    if (dir_fd < 0 || fsync(dir_fd) != 0) {
+        perror("checkpoint: fsync directory");
+        if (dir_fd >= 0) close(dir_fd);
+        return -1;
+    }
+    close(dir_fd);
+    return 0;
+}
+
+static void *checkpoint_writer_main(void *arg) {
+    struct checkpoint_writer *w = arg;
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (!w->pending && !w->quit) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (!w->pending && w->quit) {
+            break;
+        }
+        // we don't hold the lock while writing, the main thread won't touch the snapshot while pending is 1
+        pthread_mutex_unlock(&w->lock);
+        int ok = write_checkpoint_file(w->path, &w->header, w->centroids, w->labels) == 0;
+        pthread_mutex_lock(&w->lock);
+        if (ok) w->written++;
+        else w->failed++;
+        w->last_ok = ok;
+        w->pending = 0;
+        pthread_cond_broadcast(&w->cond);  // wakes up the main thread if it is waiting for the final checkpoint
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+
+// returns 1 if the snapshot was handed over to the writer, 0 if the writer was still busy and this checkpoint got skipped
+static int checkpoint_async(struct checkpoint_writer *w, int iter, int changed, double centroids[K][DIM], const label_t *labels) {
+    pthread_mutex_lock(&w->lock);
+    if (w->pending) {
+        pthread_mutex_unlock(&w->lock);
+        return 0;
+    }
+    w->header.iter = iter;
+    w->header.changed = changed;
+    memcpy(w->centroids, centroids, sizeof(w->centroids));
+    if (w->labels != NULL) {
+        memcpy(w->labels, labels, NUM_POINTS * sizeof(label_t));
+    }
+    w->pending = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return 1;
+}
+
+// reads the checkpoint back, returns 0 on success. labels may be NULL if the caller doesn't want them
+static int read_checkpoint_file(const char *path, struct checkpoint_header *h, double centroids[K][DIM], label_t *labels) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror("checkpoint: fopen");
+        return -1;
+    }
+    int ok = fread(h, sizeof(*h), 1, f) == 1;
+    if (ok && (h->magic != CHECKPOINT_MAGIC || h->version != CHECKPOINT_VERSION || h->num_points != NUM_POINTS ||
+               h->dim != DIM || h->k != K || h->label_bytes != (int)sizeof(label_t))) {
+        fprintf(stderr, "checkpoint: %s was written by an incompatible build\n", path);
+        ok = 0;
+    }
+    ok = ok && fread(centroids, sizeof(double), K * DIM, f) == K * DIM;
+    if (ok && h->has_labels && labels != NULL) {
+        ok = fread(labels, sizeof(label_t), NUM_POINTS, f) == NUM_POINTS;
+    }
+    fclose(f);
+    if (!ok) {
+        fprintf(stderr, "checkpoint: could not read %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j, iter;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <checkpoint_file> [resume] [labels]\n", argv[0]);
+        return 1;
+    }
+    const char *checkpoint_path = argv[1];
+    int resume = 0, save_labels = 0;
+    for (i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "resume") == 0) resume = 1;
+        else if (strcmp(argv[i], "labels") == 0) save_labels = 1;
+    }
+
+// ===================================================================================================================================
+// Loading/creating the data, same as before except that the seed is explicit now. On a resume the seed comes from the checkpoint so we get the same points back.
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));  // Initializes to 0.
+    double centroids[K][DIM];
+    struct checkpoint_header saved;
+    int start_iter = 0;
+    int changed = 1;  // Flag to check if any point changes its cluster.
+    unsigned int seed = SEED;
+
+    if (resume) {
+        if (read_checkpoint_file(checkpoint_path, &saved, centroids, labels) != 0) {
+            free(labels);
+            return 1;
+        }
+        seed = saved.seed;
+        start_iter = saved.iter;
+        // without saved labels every label is 0 again, so we can't trust the saved flag and have to run at least one more iteration
+        changed = saved.has_labels ? saved.changed : 1;
+        printf("Resuming from %s at iteration %d\n", checkpoint_path, start_iter);
+    }
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    srand(seed);
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    if (!resume) {
+        // Initialize centroids (K x DIM). We'll use the first K points as our initial centroids.
+        for (i = 0; i < K; i++) {
+            for (j = 0; j < DIM; j++) {
+                centroids[i][j] = data[i][j];
+            }
+        }
+    }
+
+    // start the background writer
+    struct checkpoint_writer *writer = calloc(1, sizeof(*writer));
+    writer->path = checkpoint_path;
+    writer->header.magic = CHECKPOINT_MAGIC;
+    writer->header.version = CHECKPOINT_VERSION;
+    writer->header.num_points = NUM_POINTS;
+    writer->header.dim = DIM;
+    writer->header.k = K;
+    writer->header.label_bytes = sizeof(label_t);
+    writer->header.seed = seed;
+    writer->header.has_labels = save_labels;
+    writer->labels = save_labels ? malloc(NUM_POINTS * sizeof(label_t)) : NULL;
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    pthread_create(&writer->thread, NULL, checkpoint_writer_main, writer);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop is the same as K_means_para.c, it just starts at start_iter and hands a snapshot to the writer every CHECKPOINT_EVERY iterations.
+
+    double start_time = omp_get_wtime();
+    int checkpoints_skipped = 0;
+
+    for (iter = start_iter; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        // Assignment Step: assign each point to the nearest centroid.
+        #pragma omp parallel for private(j) reduction(|:changed)
+        for (i = 0; i < NUM_POINTS; i++) {
+            int best_cluster = 0;
+            double best_dist = distance_sq(data[i], centroids[0]);
+            for (j = 1; j < K; j++) {
+                double d = distance_sq(data[i], centroids[j]);
+                if (d < best_dist) {
+                    best_dist = d;
+                    best_cluster = j;
+                }
+            }
+            if (labels[i] != best_cluster) {
+                labels[i] = (label_t)best_cluster;
+                changed |= 1;
+            }
+        }
+
+        // Update Step: recompute centroids as the mean of points in each cluster.
+        double new_centroids[K][DIM] = {0};
+        int counts[K] = {0};
+
+        // same partial sum technique as K_means_para.c
+        #pragma omp parallel
+        {
+            double local_new_centroids[K][DIM] = {0};
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int cluster = labels[i];
+                local_counts[cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[cluster][d] += data[i][d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (i = 0; i < K; i++) {
+            if (counts[i] > 0) {
+                for (j = 0; j < DIM; j++) {
+                    centroids[i][j] = new_centroids[i][j] / counts[i];
+                }
+            }
+        }
+
+        // iteration iter is complete here, so the checkpoint records iter + 1 completed iterations
+        if ((iter + 1) % CHECKPOINT_EVERY == 0) {
+            if (!checkpoint_async(writer, iter + 1, changed, centroids, labels)) checkpoints_skipped++;
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+
+    // the final state always gets written (this one we do wait for), so a finished run can also be "resumed" and will stop right away
+    pthread_mutex_lock(&writer->lock);
+    while (writer->pending) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    checkpoint_async(writer, iter, changed, centroids, labels);
+    pthread_mutex_lock(&writer->lock);
+    while (writer->pending) {
+        pthread_cond_wait(&writer->cond, &writer->lock);
+    }
+    int final_ok = writer->last_ok;
+    pthread_mutex_unlock(&writer->lock);
+    if (!final_ok) {
+        fprintf(stderr, "checkpoint: the final checkpoint could not be written to %s\n", checkpoint_path);
+    }
+
+    pthread_mutex_lock(&writer->lock);
+    writer->quit = 1;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations (%d of them in this run).\n", iter, iter - start_iter);
+    printf("Elapsed time (parallel): %f seconds\n", elapsed);
+    printf("Checkpoints written: %d, failed: %d, skipped because the writer was busy: %d\n", writer->written, writer->failed, checkpoints_skipped);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    pthread_mutex_destroy(&writer->lock);
+    pthread_cond_destroy(&writer->cond);
+    free(writer->labels);
+    free(writer);
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+
+    return final_ok ? 0 : 1;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,302 @@
+// Hierarchical (bisecting) K-Means for a very large K, like building a codebook for vector quantization.
+// With K in the thousands, flat K-Means has to compare every point against every centroid, so every assignment is O(K). Instead, here we:
+//      1. split the whole dataset into 2 clusters with the normal K-Means loop (K = 2)
+//      2. split each of those 2 clusters into 2 again, and so on, until there are K leaves. Each split only looks at the points of its own cluster,
+//         and the two halves have nothing to do with each other anymore, so every subtree is built as its own omp task.
+//      3. the splits form a tree of centroids. To assign a point we go down the tree comparing it only to the 2 children of a node, which is O(log K).
+//         going down greedily can take a wrong turn near a border, so we keep the BEAM best nodes on each level instead of just 1.
+// At the end we compare the tree assignment against brute force over all K leaf centroids (speed and how often they agree).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 1024              // Number of clusters (leaves of the tree), has to be a power of 2 since every split makes 2 clusters
+#define MAX_ITER 100        // Maximum iterations for each 2-means split
+#define BEAM 4              // how many nodes per level we keep while going down the tree
+#define TASK_CUTOFF 10000   // subtrees with fewer points than this are built by the task that reached them instead of spawning new tasks
+
+#if (K & (K - 1)) != 0
+#error "K has to be a power of 2"
+#endif
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The centroid tree is a complete binary tree stored like a heap: node n has children 2n+1 and 2n+2, there are 2K - 1 nodes and the leaves are nodes K-1 .. 2K-2
+// (so leaf number L is node K - 1 + L). Node n's centroid is the mean of all the points in its subtree.
+
+#define NUM_NODES (2 * K - 1)
+
+struct build_state {
+    double **data;
+    int *idx;                           // point indices, every node owns a contiguous range of this while building
+    unsigned char *side;                // scratch: 0 or 1 for every position of idx, which half of its split the point went to
+    double (*nodes)[DIM];               // NUM_NODES centroids
+};
+
+// the normal K-Means loop with K = 2 over the points idx[lo .. hi), writes the two centroids into c0 and c1
+static void two_means(struct build_state *s, int lo, int hi, double c0[DIM], double c1[DIM]) {
+    // starting centroids: the point furthest from the first point of the range, and the point furthest from that one. on a tiny range this
+    // still works (they might be the same point, then one half stays empty).
+    double *first = s->data[s->idx[lo]];
+    int a = lo, b = lo;
+    double far = -1.0;
+    for (int p = lo; p < hi; p++) {
+        double d = distance_sq(s->data[s->idx[p]], first);
+        if (d > far) { far = d; a = p; }
+    }
+    far = -1.0;
+    for (int p = lo; p < hi; p++) {
+        double d = distance_sq(s->data[s->idx[p]], s->data[s->idx[a]]);
+        if (d > far) { far = d; b = p; }
+    }
+    memcpy(c0, s->data[s->idx[a]], sizeof(double) * DIM);
+    memcpy(c1, s->data[s->idx[b]], sizeof(double) * DIM);
+    memset(s->side + lo, 0, hi - lo);
+
+    int changed = 1;
+    for (int iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        double sums[2][DIM] = {{0}};
+        int counts[2] = {0};
+        for (int p = lo; p < hi; p++) {
+            double *point = s->data[s->idx[p]];
+            unsigned char side = distance_sq(point, c1) < distance_sq(point, c0);
+            if (s->side[p] != side) {
+                s->side[p] = side;
+                changed = 1;
+            }
+            counts[side]++;
+            for (int d = 0; d < DIM; d++) {
+                sums[side][d] += point[d];
+            }
+        }
+        for (int d = 0; d < DIM; d++) {
+            if (counts[0] > 0) c0[d] = sums[0][d] / counts[0];
+            if (counts[1] > 0) c1[d] = sums[1][d] / counts[1];
+        }
+    }
+}
+
+// splits node n (which owns idx[lo .. hi)) and recurses into both halves
+static void build_subtree(struct build_state *s, int n, int lo, int hi) {
+    if (n >= K - 1) return;     // leaf
+    int left = 2 * n + 1, right = 2 * n + 2;
+
+    if (hi - lo < 2) {
+        // nothing left to split, both children just copy the parent so every leaf still has a centroid
+        memcpy(s->nodes[left], s->nodes[n], sizeof(double) * DIM);
+        memcpy(s->nodes[right], s->nodes[n], sizeof(double) * DIM);
+    } else {
+        two_means(s, lo, hi, s->nodes[left], s->nodes[right]);
+    }
+
+    // move the side 0 points to the front of the range so each child owns a contiguous range again
+    int mid = lo;
+    for (int p = lo; p < hi; p++) {
+        if (s->side[p] == 0 || hi - lo < 2) {
+            int t = s->idx[p];
+            s->idx[p] = s->idx[mid];
+            s->idx[mid] = t;
+            mid++;
+        }
+    }
+
+    #pragma omp task if(hi - lo > TASK_CUTOFF)
+    build_subtree(s, left, lo, mid);
+    #pragma omp task if(hi - lo > TASK_CUTOFF)
+    build_subtree(s, right, mid, hi);
+    #pragma omp taskwait
+}
+
+// going down the tree keeping the BEAM closest nodes on each level, returns the leaf number (0 .. K-1)
+static int tree_assign(double (*nodes)[DIM], double *point) {
+    int beam[BEAM], next[2 * BEAM];
+    double next_dist[2 * BEAM];
+    int beam_size = 1;
+    beam[0] = 0;
+
+    while (beam[0] < K - 1) {   // all the nodes in the beam are on the same level, so checking one is enough
+        int n = 0;
+        for (int b = 0; b < beam_size; b++) {
+            for (int c = 2 * beam[b] + 1; c <= 2 * beam[b] + 2; c++) {
+                next[n] = c;
+                next_dist[n] = distance_sq(point, nodes[c]);
+                n++;
+            }
+        }
+        // keep the BEAM best children (partial selection sort, n is at most 2 * BEAM)
+        beam_size = n < BEAM ? n : BEAM;
+        for (int b = 0; b < beam_size; b++) {
+            int best = b;
+            for (int c = b + 1; c < n; c++) {
+                if (next_dist[c] < next_dist[best] || (next_dist[c] == next_dist[best] && next[c] < next[best])) best = c;
+            }
+            int t = next[b]; next[b] = next[best]; next[best] = t;
+            double td = next_dist[b]; next_dist[b] = next_dist[best]; next_dist[best] = td;
+            beam[b] = next[b];
+        }
+    }
+    return beam[0] - (K - 1);
+}
+
+// ===================================================================================================================================
+
+
+
+int main() {
+
+    int i, j;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = malloc(NUM_POINTS * sizeof(label_t));
+    label_t *exact_labels = malloc(NUM_POINTS * sizeof(label_t));
+    double (*nodes)[DIM] = malloc(NUM_NODES * sizeof(*nodes));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Building the tree. The root centroid is the mean of everything.
+
+    double start_time = omp_get_wtime();
+
+    struct build_state s;
+    s.data = data;
+    s.nodes = nodes;
+    s.idx = malloc(NUM_POINTS * sizeof(int));
+    s.side = malloc(NUM_POINTS);
+    for (i = 0; i < NUM_POINTS; i++) {
+        s.idx[i] = i;
+    }
+    for (j = 0; j < DIM; j++) {
+        double sum = 0.0;
+        for (i = 0; i < NUM_POINTS; i++) {
+            sum += data[i][j];
+        }
+        nodes[0][j] = sum / NUM_POINTS;
+    }
+
+    #pragma omp parallel
+    #pragma omp single
+    build_subtree(&s, 0, 0, NUM_POINTS);
+
+    double build_time = omp_get_wtime() - start_time;
+    double (*leaves)[DIM] = &nodes[K - 1];
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Assigning every point to a leaf, once through the tree and once by brute force over all K leaves for comparison
+
+    double tree_start = omp_get_wtime();
+    double tree_error = 0.0;
+    #pragma omp parallel for reduction(+:tree_error)
+    for (i = 0; i < NUM_POINTS; i++) {
+        int leaf = tree_assign(nodes, data[i]);
+        labels[i] = (label_t)leaf;
+        tree_error += distance_sq(data[i], leaves[leaf]);
+    }
+    double tree_time = omp_get_wtime() - tree_start;
+
+    double exact_start = omp_get_wtime();
+    double exact_error = 0.0;
+    #pragma omp parallel for private(j) reduction(+:exact_error)
+    for (i = 0; i < NUM_POINTS; i++) {
+        int best_cluster = 0;
+        double best_dist = distance_sq(data[i], leaves[0]);
+        for (j = 1; j < K; j++) {
+            double d = distance_sq(data[i], leaves[j]);
+            if (d < best_dist) {
+                best_dist = d;
+                best_cluster = j;
+            }
+        }
+        exact_labels[i] = (label_t)best_cluster;
+        exact_error += best_dist;
+    }
+    double exact_time = omp_get_wtime() - exact_start;
+
+    int agree = 0;
+    #pragma omp parallel for reduction(+:agree)
+    for (i = 0; i < NUM_POINTS; i++) {
+        agree += labels[i] == exact_labels[i];
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results. with K this big we print the statistics instead of every centroid
+    printf("Built a tree with %d leaves in %f seconds\n", K, build_time);
+    printf("Tree assignment (beam %d):  %f seconds, mean squared error %g\n", BEAM, tree_time, tree_error / NUM_POINTS);
+    printf("Brute force assignment:    %f seconds, mean squared error %g\n", exact_time, exact_error / NUM_POINTS);
+    printf("Tree and brute force agree on %.2f%% of the points\n", 100.0 * agree / NUM_POINTS);
+    printf("First leaf centroids:\n");
+    for (i = 0; i < K && i < 4; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", leaves[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    free(s.idx);
+    free(s.side);
+    free(nodes);
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+    free(exact_labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,425 @@
+// Same K-Means as K_means_para.c but the assignment step uses a kd-tree ("filtering" algorithm from Kanungo et al.) instead of checking every point against every centroid.
+// Since DIM is 2 here, a kd-tree works really well: every node of the tree knows the bounding box of its points and their sum/count, so if one centroid is closer
+// than all the others to the whole box, the whole subtree goes to that centroid in O(1) using the cached sum, without touching the points at all.
+// Only the points near the borders between clusters end up being checked one by one.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define LEAF_SIZE 32            // nodes with this many points or less are not split any further
+#define TASK_CUTOFF 50000       // subtrees bigger than this become separate omp tasks (both for building and for filtering)
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The kd-tree. Points are reordered so every node covers a contiguous range [first, first + count) of the reordered arrays.
+// owner is what makes the labels work without touching every point: if owner is c then every point in the subtree has label c
+// (and the labels/owners further down may be out of date, they get fixed when we go down into the node again). owner is -1 when the subtree is mixed.
+
+struct kd_node {
+    double lo[DIM], hi[DIM];    // bounding box of the points
+    double sum[DIM];            // sum of the points, so a whole subtree can be added to a centroid at once
+    int first, count;
+    int left, right;            // child node indices, -1 for leaves
+    int owner;
+};
+
+struct kd_tree {
+    struct kd_node *nodes;
+    int num_nodes;
+    int *order;                 // order[p] = index in data of the p-th reordered point
+    double *points;             // reordered copy of the points, stored flat
+    label_t *labels;            // labels in the reordered order
+};
+
+// per thread accumulators for the filtering step, padded so two threads never share a cache line
+struct kd_partial {
+    double sums[K][DIM];
+    int counts[K];
+    int changed;
+    char pad[64];
+};
+
+// swaps two points of the reordered arrays (the coordinates and where they came from)
+static void kd_swap(struct kd_tree *t, int a, int b) {
+    int o = t->order[a];
+    t->order[a] = t->order[b];
+    t->order[b] = o;
+    for (int d = 0; d < DIM; d++) {
+        double x = t->points[(size_t)a * DIM + d];
+        t->points[(size_t)a * DIM + d] = t->points[(size_t)b * DIM + d];
+        t->points[(size_t)b * DIM + d] = x;
+    }
+}
+
+// quickselect on [first, first + n): afterwards point first + mid has the median coordinate along dim, everything before it is <= and everything after is >=
+static void select_median(struct kd_tree *t, int first, int n, int mid, int dim) {
+    double *pts = t->points;
+    int lo = first, hi = first + n - 1;
+    mid += first;
+    while (lo < hi) {
+        double pivot = pts[(size_t)((lo + hi) / 2) * DIM + dim];
+        int a = lo, b = hi;
+        while (a <= b) {
+            while (pts[(size_t)a * DIM + dim] < pivot) a++;
+            while (pts[(size_t)b * DIM + dim] > pivot) b--;
+            if (a <= b) {
+                kd_swap(t, a, b);
+                a++;
+                b--;
+            }
+        }
+        if (mid <= b) hi = b;
+        else if (mid >= a) lo = a;
+        else break;
+    }
+}
+
+static int kd_build(struct kd_tree *t, int first, int count) {
+    int n;
+    #pragma omp atomic capture
+    n = t->num_nodes++;
+    struct kd_node *node = &t->nodes[n];
+    double *pts = t->points + (size_t)first * DIM;
+
+    node->first = first;
+    node->count = count;
+    node->owner = 0;        // labels start at 0, same as the calloc in the other versions
+    for (int d = 0; d < DIM; d++) {
+        node->lo[d] = node->hi[d] = pts[d];
+        node->sum[d] = 0.0;
+    }
+    for (int p = 0; p < count; p++) {
+        for (int d = 0; d < DIM; d++) {
+            double x = pts[(size_t)p * DIM + d];
+            if (x < node->lo[d]) node->lo[d] = x;
+            if (x > node->hi[d]) node->hi[d] = x;
+            node->sum[d] += x;
+        }
+    }
+
+    if (count <= LEAF_SIZE) {
+        node->left = node->right = -1;
+        return n;
+    }
+
+    // split the widest side of the box at the median so the tree stays balanced
+    int split = 0;
+    for (int d = 1; d < DIM; d++) {
+        if (node->hi[d] - node->lo[d] > node->hi[split] - node->lo[split]) split = d;
+    }
+    int half = count / 2;
+    select_median(t, first, count, half, split);
+
+    int left, right;
+    #pragma omp task shared(left) if(count > TASK_CUTOFF)
+    left = kd_build(t, first, half);
+    right = kd_build(t, first + half, count - half);
+    #pragma omp taskwait
+    node->left = left;
+    node->right = right;
+    return n;
+}
+
+static struct kd_tree *kd_tree_create(double **data) {
+    struct kd_tree *t = malloc(sizeof(*t));
+    // with median splits a tree over n points never has more than 2 * n / (LEAF_SIZE / 2) nodes
+    t->nodes = malloc((4 * (NUM_POINTS / LEAF_SIZE + 1)) * sizeof(struct kd_node));
+    t->num_nodes = 0;
+    t->order = malloc(NUM_POINTS * sizeof(int));
+    t->points = malloc((size_t)NUM_POINTS * DIM * sizeof(double));
+    t->labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    // the tree works on a flat copy of the points which the build reorders in place, so the leaves end up reading memory sequentially
+    #pragma omp parallel for
+    for (int p = 0; p < NUM_POINTS; p++) {
+        t->order[p] = p;
+        for (int d = 0; d < DIM; d++) {
+            t->points[(size_t)p * DIM + d] = data[p][d];
+        }
+    }
+    #pragma omp parallel
+    #pragma omp single
+    kd_build(t, 0, NUM_POINTS);
+    return t;
+}
+
+// the owner of a node is only valid while we are not looking below it, so before going down we hand it to the children (for a leaf that means writing the labels)
+static void kd_push_owner(struct kd_tree *t, struct kd_node *node) {
+    if (node->owner < 0) return;
+    if (node->left < 0) {
+        for (int p = node->first; p < node->first + node->count; p++) {
+            t->labels[p] = (label_t)node->owner;
+        }
+    } else {
+        t->nodes[node->left].owner = node->owner;
+        t->nodes[node->right].owner = node->owner;
+    }
+}
+
+// Kanungo's pruning test: is centroid z further than centroid best from every point of the box? we only have to check the corner of the box in the direction of z - best
+static int kd_is_farther(const struct kd_node *node, double z[], double best[]) {
+    double corner[DIM];
+    for (int d = 0; d < DIM; d++) {
+        corner[d] = z[d] > best[d] ? node->hi[d] : node->lo[d];
+    }
+    return distance_sq(z, corner) > distance_sq(best, corner);
+}
+
+static void kd_filter(struct kd_tree *t, int n, double centroids[K][DIM], const int *candidates, int num_candidates, struct kd_partial *partials) {
+    struct kd_node *node = &t->nodes[n];
+
+    // find the candidate closest to the middle of the box, then drop every candidate that is further than it from the whole box
+    double mid[DIM];
+    for (int d = 0; d < DIM; d++) {
+        mid[d] = 0.5 * (node->lo[d] + node->hi[d]);
+    }
+    int best = candidates[0];
+    double best_dist = distance_sq(mid, centroids[best]);
+    for (int c = 1; c < num_candidates; c++) {
+        double dist = distance_sq(mid, centroids[candidates[c]]);
+        if (dist < best_dist) {
+            best_dist = dist;
+            best = candidates[c];
+        }
+    }
+    int kept[K];
+    int num_kept = 0;
+    for (int c = 0; c < num_candidates; c++) {
+        if (candidates[c] == best || !kd_is_farther(node, centroids[candidates[c]], centroids[best])) {
+            kept[num_kept++] = candidates[c];   // stays sorted, so ties are broken by the lowest index like the brute force loop
+        }
+    }
+
+    // only one centroid left: the whole subtree is assigned to it at once
+    if (num_kept == 1) {
+        struct kd_partial *mine = &partials[omp_get_thread_num()];
+        if (node->owner != best) mine->changed = 1;
+        node->owner = best;
+        mine->counts[best] += node->count;
+        for (int d = 0; d < DIM; d++) {
+            mine->sums[best][d] += node->sum[d];
+        }
+        return;
+    }
+
+    kd_push_owner(t, node);
+
+    if (node->left < 0) {
+        // leaf with more than one candidate left: do the normal assignment, but only against the remaining candidates
+        struct kd_partial *mine = &partials[omp_get_thread_num()];
+        int owner = -2;
+        for (int p = node->first; p < node->first + node->count; p++) {
+            double *point = &t->points[(size_t)p * DIM];
+            int best_cluster = kept[0];
+            double best_d = distance_sq(point, centroids[kept[0]]);
+            for (int c = 1; c < num_kept; c++) {
+                double dist = distance_sq(point, centroids[kept[c]]);
+                if (dist < best_d) {
+                    best_d = dist;
+                    best_cluster = kept[c];
+                }
+            }
+            if (t->labels[p] != best_cluster) {
+                t->labels[p] = (label_t)best_cluster;
+                mine->changed = 1;
+            }
+            mine->counts[best_cluster]++;
+            for (int d = 0; d < DIM; d++) {
+                mine->sums[best_cluster][d] += point[d];
+            }
+            owner = (owner == -2 || owner == best_cluster) ? best_cluster : -1;
+        }
+        node->owner = owner;
+        return;
+    }
+
+    #pragma omp task if(node->count > TASK_CUTOFF)
+    kd_filter(t, node->left, centroids, kept, num_kept, partials);
+    kd_filter(t, node->right, centroids, kept, num_kept, partials);
+    #pragma omp taskwait
+    int l = t->nodes[node->left].owner, r = t->nodes[node->right].owner;
+    node->owner = l == r ? l : -1;
+}
+
+// writes the final labels back in the original point order (the owners up in the tree still have to be pushed down first)
+static void kd_collect_labels(struct kd_tree *t, int n, label_t *labels) {
+    struct kd_node *node = &t->nodes[n];
+    if (node->owner >= 0) {
+        for (int p = node->first; p < node->first + node->count; p++) {
+            labels[t->order[p]] = (label_t)node->owner;
+        }
+    } else if (node->left < 0) {
+        for (int p = node->first; p < node->first + node->count; p++) {
+            labels[t->order[p]] = t->labels[p];
+        }
+    } else {
+        kd_collect_labels(t, node->left, labels);
+        kd_collect_labels(t, node->right, labels);
+    }
+}
+
+static void kd_tree_free(struct kd_tree *t) {
+    free(t->nodes);
+    free(t->order);
+    free(t->points);
+    free(t->labels);
+    free(t);
+}
+
+// ===================================================================================================================================
+
+
+
+int main() {
+
+    int i, j, iter;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Building the tree, this only happens once so it is timed separately from the iterations.
+
+    double build_start = omp_get_wtime();
+    struct kd_tree *tree = kd_tree_create(data);
+    double build_time = omp_get_wtime() - build_start;
+
+    int num_threads = omp_get_max_threads();
+    struct kd_partial *partials = malloc(num_threads * sizeof(struct kd_partial));
+    int all_candidates[K];
+    for (i = 0; i < K; i++) {
+        all_candidates[i] = i;
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop: the filtering pass does the assignment and the summation at the same time, then the per thread partials are merged like in K_means_para.c
+
+    double start_time = omp_get_wtime();
+
+    int changed = 1;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        memset(partials, 0, num_threads * sizeof(struct kd_partial));
+
+        #pragma omp parallel
+        #pragma omp single
+        kd_filter(tree, 0, centroids, all_candidates, K, partials);
+
+        double new_centroids[K][DIM] = {0};
+        int counts[K] = {0};
+        changed = 0;
+        for (int t = 0; t < num_threads; t++) {
+            changed |= partials[t].changed;
+            for (int c = 0; c < K; c++) {
+                counts[c] += partials[t].counts[c];
+                for (int d = 0; d < DIM; d++) {
+                    new_centroids[c][d] += partials[t].sums[c][d];
+                }
+            }
+        }
+
+        for (i = 0; i < K; i++) {
+            if (counts[i] > 0) {
+                for (j = 0; j < DIM; j++) {
+                    centroids[i][j] = new_centroids[i][j] / counts[i];
+                }
+            }
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+
+    kd_collect_labels(tree, 0, labels);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations.\n", iter);
+    printf("Tree build time: %f seconds (%d nodes)\n", build_time, tree->num_nodes);
+    printf("Elapsed time (kd-tree): %f seconds\n", elapsed);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    kd_tree_free(tree);
+    free(partials);
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
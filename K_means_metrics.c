@@ -0,0 +1,326 @@
+// K-Means with other distance metrics than squared Euclidean. Every metric is a pair of a distance function and an update step:
+//      euclidean  -> distance_sq and the mean (exactly K_means_para.c)
+//      manhattan  -> sum of |differences| and the per dimension median of the cluster (that is what minimizes L1, so this is k-medians)
+//      cosine     -> 1 - cos(angle). the points are normalized once up front and the new centroid is the mean pushed back onto the unit circle
+//                    (spherical k-means), so the distance is just 1 - dot product
+//      weighted   -> Euclidean with a weight per dimension (a diagonal Mahalanobis distance, see dim_weights), the mean is still the right update
+// Every metric gets its own copy of the assignment loop and the K-Means loop, stamped out by the DEFINE_KMEANS macro with the distance function and
+// the update step of that metric plugged in directly. The distance functions are static inline, so they get inlined into their loop: picking a metric
+// costs one switch in main, and the Euclidean loop is the same code as before, no function pointer call per distance.
+// usage: ./K_means_metrics [euclidean | manhattan | cosine | weighted]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+// weighted metric: how much each dimension counts. {1, 1} would be plain Euclidean
+#if DIM != 2
+#error "dim_weights has one weight per dimension for DIM 2, give every dimension a weight when changing DIM"
+#endif
+static const double dim_weights[DIM] = {1.0, 4.0};
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+static inline double distance_sq(const double p1[], const double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The other distances. cosine assumes both vectors have length 1 (the points are normalized in main, the centroids by update_normalized_mean).
+
+static inline double distance_l1(const double p1[], const double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        sum += fabs(p1[d] - p2[d]);
+    }
+    return sum;
+}
+
+static inline double distance_cosine(const double p1[], const double p2[]) {
+    double dot = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        dot += p1[d] * p2[d];
+    }
+    return 1.0 - dot;
+}
+
+static inline double distance_weighted(const double p1[], const double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += dim_weights[d] * diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The update steps. They all get the same arguments; sums / counts are filled in by the assignment, scratch is NUM_POINTS * DIM doubles of space.
+
+static void update_mean(const double *points, const label_t *labels, double sums[K][DIM], int counts[K], double centroids[K][DIM], double *scratch) {
+    (void)points; (void)labels; (void)scratch;
+    for (int c = 0; c < K; c++) {
+        if (counts[c] > 0) {
+            for (int d = 0; d < DIM; d++) {
+                centroids[c][d] = sums[c][d] / counts[c];
+            }
+        }
+    }
+}
+
+static void update_normalized_mean(const double *points, const label_t *labels, double sums[K][DIM], int counts[K], double centroids[K][DIM], double *scratch) {
+    (void)points; (void)labels; (void)scratch;
+    for (int c = 0; c < K; c++) {
+        double norm = 0.0;
+        for (int d = 0; d < DIM; d++) {
+            norm += sums[c][d] * sums[c][d];
+        }
+        norm = sqrt(norm);
+        if (counts[c] > 0 && norm > 0.0) {
+            for (int d = 0; d < DIM; d++) {
+                centroids[c][d] = sums[c][d] / norm;
+            }
+        }
+    }
+}
+
+// the k-th smallest of a[0 .. n-1] (quickselect, reorders a)
+static double select_kth(double *a, int n, int k) {
+    int lo = 0, hi = n - 1;
+    while (lo < hi) {
+        double pivot = a[lo + (hi - lo) / 2];
+        int i = lo, j = hi;
+        while (i <= j) {
+            while (a[i] < pivot) i++;
+            while (a[j] > pivot) j--;
+            if (i <= j) {
+                double t = a[i];
+                a[i] = a[j];
+                a[j] = t;
+                i++;
+                j--;
+            }
+        }
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
+    }
+    return a[k];
+}
+
+// median per cluster and dimension (the lower one for an even count). The values get sorted into scratch by dimension and cluster
+// (a counting sort on the labels), after which every (cluster, dimension) pair is its own quickselect and they run in parallel
+static void update_median(const double *points, const label_t *labels, double sums[K][DIM], int counts[K], double centroids[K][DIM], double *scratch) {
+    (void)sums;
+    long offsets[K];
+    long fill[K];
+    long total = 0;
+    for (int c = 0; c < K; c++) {
+        offsets[c] = total;
+        fill[c] = total;
+        total += counts[c];
+    }
+    for (long i = 0; i < NUM_POINTS; i++) {
+        long pos = fill[labels[i]]++;
+        for (int d = 0; d < DIM; d++) {
+            scratch[(size_t)d * NUM_POINTS + pos] = points[(size_t)i * DIM + d];
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int cd = 0; cd < K * DIM; cd++) {
+        int c = cd / DIM, d = cd % DIM;
+        if (counts[c] > 0) {
+            centroids[c][d] = select_kth(&scratch[(size_t)d * NUM_POINTS + offsets[c]], counts[c], (counts[c] - 1) / 2);
+        }
+    }
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop of K_means_para.c, one copy per metric. kmeans_<name>(points, centroids, labels, scratch) returns the number of iterations.
+
+#define DEFINE_KMEANS(name, DISTANCE, UPDATE)                                                                                   \
+static int kmeans_##name(const double *points, double centroids[K][DIM], label_t *labels, double *scratch) {                    \
+    int iter;                                                                                                                   \
+    int changed = 1;                                                                                                            \
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {                                                                        \
+        changed = 0;                                                                                                            \
+        double new_centroids[K][DIM] = {{0}};                                                                                   \
+        int counts[K] = {0};                                                                                                    \
+                                                                                                                                \
+        _Pragma("omp parallel reduction(|:changed)")                                                                            \
+        {                                                                                                                       \
+            double local_new_centroids[K][DIM] = {{0}};                                                                         \
+            int local_counts[K] = {0};                                                                                          \
+                                                                                                                                \
+            _Pragma("omp for nowait")                                                                                           \
+            for (int i = 0; i < NUM_POINTS; i++) {                                                                              \
+                const double *point = &points[(size_t)i * DIM];                                                                 \
+                int best_cluster = 0;                                                                                           \
+                double best_dist = DISTANCE(point, centroids[0]);                                                               \
+                for (int j = 1; j < K; j++) {                                                                                   \
+                    double d = DISTANCE(point, centroids[j]);                                                                   \
+                    if (d < best_dist) {                                                                                        \
+                        best_dist = d;                                                                                          \
+                        best_cluster = j;                                                                                       \
+                    }                                                                                                           \
+                }                                                                                                               \
+                if (labels[i] != best_cluster) {                                                                                \
+                    labels[i] = (label_t)best_cluster;                                                                          \
+                    changed |= 1;                                                                                               \
+                }                                                                                                               \
+                local_counts[best_cluster]++;                                                                                   \
+                for (int d = 0; d < DIM; d++) {                                                                                 \
+                    local_new_centroids[best_cluster][d] += point[d];                                                           \
+                }                                                                                                               \
+            }                                                                                                                   \
+                                                                                                                                \
+            _Pragma("omp critical")                                                                                             \
+            {                                                                                                                   \
+                for (int c = 0; c < K; c++) {                                                                                   \
+                    counts[c] += local_counts[c];                                                                               \
+                    for (int d = 0; d < DIM; d++) {                                                                             \
+                        new_centroids[c][d] += local_new_centroids[c][d];                                                       \
+                    }                                                                                                           \
+                }                                                                                                               \
+            }                                                                                                                   \
+        }                                                                                                                       \
+                                                                                                                                \
+        UPDATE(points, labels, new_centroids, counts, centroids, scratch);                                                      \
+    }                                                                                                                           \
+    return iter;                                                                                                                \
+}
+
+DEFINE_KMEANS(euclidean, distance_sq, update_mean)
+DEFINE_KMEANS(manhattan, distance_l1, update_median)
+DEFINE_KMEANS(cosine, distance_cosine, update_normalized_mean)
+DEFINE_KMEANS(weighted, distance_weighted, update_mean)
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+    const char *metric = argc > 1 ? argv[1] : "euclidean";
+    int is_cosine = strcmp(metric, "cosine") == 0;
+
+// ===================================================================================================================================
+// Creating the data, same values as K_means_para.c but in one flat block
+
+    double *points = malloc((size_t)NUM_POINTS * DIM * sizeof(double));
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            points[(size_t)i * DIM + j] = (double)rand() / RAND_MAX;
+        }
+    }
+    if (is_cosine) {
+        // only the direction counts for cosine, so every point is scaled to length 1 once here instead of in every distance
+        #pragma omp parallel for
+        for (i = 0; i < NUM_POINTS; i++) {
+            double *point = &points[(size_t)i * DIM];
+            double norm = sqrt(distance_sq(point, (const double[DIM]){0}));
+            if (norm > 0.0) {
+                for (int d = 0; d < DIM; d++) {
+                    point[d] /= norm;
+                }
+            }
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+    double *scratch = strcmp(metric, "manhattan") == 0 ? malloc((size_t)NUM_POINTS * DIM * sizeof(double)) : NULL;
+
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = points[(size_t)i * DIM + j];
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The metric is picked once here, everything below this switch is the specialized code
+
+    double start_time = omp_get_wtime();
+    int iter;
+    if (strcmp(metric, "euclidean") == 0) {
+        iter = kmeans_euclidean(points, centroids, labels, scratch);
+    } else if (strcmp(metric, "manhattan") == 0) {
+        iter = kmeans_manhattan(points, centroids, labels, scratch);
+    } else if (is_cosine) {
+        iter = kmeans_cosine(points, centroids, labels, scratch);
+    } else if (strcmp(metric, "weighted") == 0) {
+        iter = kmeans_weighted(points, centroids, labels, scratch);
+    } else {
+        fprintf(stderr, "unknown metric %s (euclidean, manhattan, cosine or weighted)\n", metric);
+        return 1;
+    }
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means (%s) converged in %d iterations.\n", metric, iter);
+    printf("Elapsed time (parallel): %f seconds\n", elapsed);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    free(points);
+    free(labels);
+    free(scratch);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,302 @@
+// Multi-resolution K-Means: most of the iterations of a normal run are the centroids making big coarse moves, and a small sample of the data would make
+// those same moves just as well. So we first cluster a 1% sample until it converges, use those centroids to start a 10% sample, and only then run
+// on the full data, which now starts close to the answer and only needs a few refinement iterations.
+// The program also does a normal run from the first K points (like K_means_para.c) so the two can be compared.
+// On the usual uniform data there is no real structure for the samples to find and the gain is not reliable: depending on the machine the
+// multi-resolution run has come out faster or SLOWER than the normal one. With "blobs" the points come in
+// NUM_BLOBS clusters (like K_means_quantized.c), where the normal run spends many iterations moving centroids between blobs and the samples can do
+// that part for a fraction of the cost.
+// usage: ./K_means_multires [blobs]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define TOLERANCE 0.0001     // stop once fewer than this fraction of the points change cluster in an iteration (applies to the normal run too)
+#define SAMPLE_SEED 12345u  // the samples only depend on this, not on the number of threads
+#define NUM_LEVELS 2        // sample levels before the full data
+static const double sample_fractions[NUM_LEVELS] = {0.01, 0.10};   // increasing, the last one is the biggest sample
+#define NUM_BLOBS 20        // blobs mode: number of clusters in the generated data
+#define SPREAD 0.3          // blobs mode: size of a blob
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Sampling. Whether point i is in the sample is decided by a hash of (i, seed) alone, so any thread can decide for any point and the result is the
+// same no matter how the loop gets split up. since the test is "hash < fraction", the 1% sample is automatically part of the 10% sample.
+
+static unsigned int sample_hash(unsigned int i, unsigned int seed) {
+    // a small integer mixer (the finalizer of murmur3)
+    unsigned int h = i ^ seed;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// fills idx with the sampled point indices (in increasing order) and returns how many there are.
+// each thread counts its hits first, then a prefix sum over the threads tells every thread where its part of idx starts
+static int build_sample(int *idx, double fraction) {
+    unsigned int threshold = (unsigned int)(fraction * 4294967295.0);
+    int num_threads = omp_get_max_threads();
+    int *offsets = calloc(num_threads + 1, sizeof(int));
+    int total = 0;
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        int nt = omp_get_num_threads();
+        int lo = (int)((long)NUM_POINTS * t / nt), hi = (int)((long)NUM_POINTS * (t + 1) / nt);
+        int count = 0;
+        for (int i = lo; i < hi; i++) {
+            count += sample_hash(i, SAMPLE_SEED) < threshold;
+        }
+        offsets[t + 1] = count;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int u = 0; u < nt; u++) {
+                offsets[u + 1] += offsets[u];
+            }
+            total = offsets[nt];
+        }
+        int out = offsets[t];
+        for (int i = lo; i < hi; i++) {
+            if (sample_hash(i, SAMPLE_SEED) < threshold) idx[out++] = i;
+        }
+    }
+    free(offsets);
+    return total;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop of K_means_para.c over n points (the full data, or the gathered copy of a sample). changed counts the points that switched cluster instead of being a flag here, so we can stop at TOLERANCE
+// (the last iterations on the full data only move a handful of border points, which is exactly the part the samples can't save us).
+// returns the number of iterations.
+
+int kmeans_points(double **points, int n, double centroids[K][DIM], label_t *labels) {
+    int iter;
+    long changed = n;
+    for (iter = 0; iter < MAX_ITER && changed > (long)(TOLERANCE * n); iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {{0}};
+        int counts[K] = {0};
+
+        #pragma omp parallel reduction(+:changed)
+        {
+            double local_new_centroids[K][DIM] = {{0}};
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < n; i++) {
+                double *point = points[i];
+                int best_cluster = 0;
+                double best_dist = distance_sq(point, centroids[0]);
+                for (int j = 1; j < K; j++) {
+                    double d = distance_sq(point, centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed++;
+                }
+                local_counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[best_cluster][d] += point[d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+    int blobs = argc > 1 && strcmp(argv[1], "blobs") == 0;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c (or blobs: a random blob center plus up to SPREAD / 2 of noise per coordinate)
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    // only drawn in blobs mode, otherwise the rand() sequence (and so the data) would no longer be the one of K_means_para.c
+    double blob_centers[NUM_BLOBS][DIM];
+    if (blobs) {
+        for (i = 0; i < NUM_BLOBS; i++) {
+            for (j = 0; j < DIM; j++) {
+                blob_centers[i][j] = (double)rand() / RAND_MAX;
+            }
+        }
+    }
+    for (i = 0; i < NUM_POINTS; i++) {
+        int blob = blobs ? rand() % NUM_BLOBS : 0;
+        for (j = 0; j < DIM; j++) {
+            double r = (double)rand() / RAND_MAX;
+            data[i][j] = blobs ? blob_centers[blob][j] + SPREAD * (r - 0.5) : r;
+        }
+    }
+
+    label_t *labels = malloc(NUM_POINTS * sizeof(label_t));
+    int *idx = malloc(NUM_POINTS * sizeof(int));
+    // the sampled points get copied next to each other, going through idx would mean a cache miss for almost every point of a sample.
+    // only the biggest sample needs room, with some slack since the hash only gives about fraction * NUM_POINTS points (a sample that still comes out bigger gets cut to max_sample in the level loop)
+    int max_sample = (int)(sample_fractions[NUM_LEVELS - 1] * NUM_POINTS * 1.1) + 1000;
+    if (max_sample > NUM_POINTS) max_sample = NUM_POINTS;
+    double *sample_storage = malloc((size_t)max_sample * DIM * sizeof(double));
+    double **sample = malloc(max_sample * sizeof(double *));
+    double centroids[K][DIM];
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Multi-resolution run: every level starts from the centroids of the level before it, the first one from the first K points like usual.
+
+    int level_points[NUM_LEVELS + 1], level_iterations[NUM_LEVELS + 1];
+    double level_time[NUM_LEVELS + 1];
+
+    double start_time = omp_get_wtime();
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+    for (int level = 0; level <= NUM_LEVELS; level++) {
+        double t = omp_get_wtime();
+        int full = level == NUM_LEVELS;
+        int n = full ? NUM_POINTS : build_sample(idx, sample_fractions[level]);
+        if (!full && n > max_sample) n = max_sample;    // the sample is a little bigger than expected, drop the tail
+        if (!full) {
+            #pragma omp parallel for
+            for (int s = 0; s < n; s++) {
+                sample[s] = &sample_storage[(size_t)s * DIM];
+                memcpy(sample[s], data[idx[s]], DIM * sizeof(double));
+            }
+        }
+        memset(labels, 0, n * sizeof(label_t));
+        level_points[level] = n;
+        level_iterations[level] = kmeans_points(full ? data : sample, n, centroids, labels);
+        level_time[level] = omp_get_wtime() - t;
+    }
+    double multires_time = omp_get_wtime() - start_time;
+
+    double multires_centroids[K][DIM];
+    memcpy(multires_centroids, centroids, sizeof(centroids));
+
+    // the normal run for comparison
+    double cold_start = omp_get_wtime();
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+    memset(labels, 0, NUM_POINTS * sizeof(label_t));
+    int cold_iterations = kmeans_points(data, NUM_POINTS, centroids, labels);
+    double cold_time = omp_get_wtime() - cold_start;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    for (int level = 0; level <= NUM_LEVELS; level++) {
+        printf("Level %d: %7d points, %3d iterations, %f seconds\n", level, level_points[level], level_iterations[level], level_time[level]);
+    }
+    printf("Elapsed time (multi-resolution): %f seconds\n", multires_time);
+    printf("Elapsed time (full data only):   %f seconds, %d iterations\n", cold_time, cold_iterations);
+    printf("Final centroids (multi-resolution | full data only):\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", multires_centroids[i][j]);
+        }
+        printf("| ");
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+    free(idx);
+    free(sample);
+    free(sample_storage);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
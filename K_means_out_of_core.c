@@ -0,0 +1,376 @@
+// Same K-Means as K_means_para.c but for datasets that don't fit in memory. Instead of keeping the whole dataset in double **data, the points live in a binary file
+// (NUM_POINTS * DIM raw doubles) and every iteration streams that file through memory one chunk at a time.
+// usage: ./K_means_out_of_core <data_file> [memory_budget_MB] [labels_file]
+//      data_file        -> if it doesn't exist yet it gets generated with the same rand() data as the other files
+//      memory_budget_MB -> upper bound for the chunk buffers (default 64)
+//      labels_file      -> optional, labels get spilled to this file. without it we don't keep labels at all and convergence is decided by how far the centroids moved
+
+#define _XOPEN_SOURCE 700   // for pread/pwrite
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define DEFAULT_BUDGET_MB 64
+#define MOVE_TOLERANCE 1e-18    // squared centroid movement below which we call it converged (only used when labels are turned off)
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Double buffering: there are 2 slots. A reader thread fills one slot from disk with pread while the main thread (and its omp threads) cluster the other one.
+// The reader just walks through the chunks 0, 1, ..., n-1, 0, 1, ... forever, since every iteration reads the file in the same order this also means
+// the first chunk of the next iteration is already being read while the last chunk of the current one is still being processed.
+
+struct chunk_slot {
+    double *points;     // chunk_points * DIM doubles, stored flat (point i is points[i*DIM .. i*DIM+DIM-1])
+    label_t *labels;    // the old labels of this chunk, NULL when labels are turned off
+    long first;         // index of the first point in this chunk
+    long count;         // number of points in this chunk
+    int full;           // 1 once the reader is done with it, 0 once the main thread hands it back
+};
+
+struct chunk_reader {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int data_fd;
+    int labels_fd;      // -1 when labels are turned off
+    long chunk_points;
+    long num_chunks;
+    int quit;
+    struct chunk_slot slots[2];
+};
+
+// pread can return less than asked for, so keep going until we have everything
+static int pread_full(int fd, void *buf, size_t len, off_t offset) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t r = pread(fd, p, len, offset);
+        if (r <= 0) return -1;
+        p += r;
+        len -= r;
+        offset += r;
+    }
+    return 0;
+}
+
+static int pwrite_full(int fd, const void *buf, size_t len, off_t offset) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t r = pwrite(fd, p, len, offset);
+        if (r <= 0) return -1;
+        p += r;
+        len -= r;
+        offset += r;
+    }
+    return 0;
+}
+
+static void *chunk_reader_main(void *arg) {
+    struct chunk_reader *r = arg;
+    long chunk = 0;
+    int s = 0;
+    for (;;) {
+        struct chunk_slot *slot = &r->slots[s];
+
+        // wait until the main thread has handed this slot back
+        pthread_mutex_lock(&r->lock);
+        while (slot->full && !r->quit) {
+            pthread_cond_wait(&r->cond, &r->lock);
+        }
+        int quit = r->quit;
+        pthread_mutex_unlock(&r->lock);
+        if (quit) break;
+
+        // the slow part happens without the lock
+        slot->first = chunk * r->chunk_points;
+        slot->count = NUM_POINTS - slot->first < r->chunk_points ? NUM_POINTS - slot->first : r->chunk_points;
+        if (pread_full(r->data_fd, slot->points, slot->count * DIM * sizeof(double), slot->first * DIM * sizeof(double)) != 0 ||
+            (r->labels_fd >= 0 && pread_full(r->labels_fd, slot->labels, slot->count * sizeof(label_t), slot->first * sizeof(label_t)) != 0)) {
+            perror("out of core: pread");
+            exit(1);
+        }
+
+        pthread_mutex_lock(&r->lock);
+        slot->full = 1;
+        pthread_cond_broadcast(&r->cond);
+        pthread_mutex_unlock(&r->lock);
+
+        chunk = (chunk + 1) % r->num_chunks;
+        s ^= 1;
+    }
+    return NULL;
+}
+
+static struct chunk_slot *wait_for_slot(struct chunk_reader *r, int s) {
+    pthread_mutex_lock(&r->lock);
+    while (!r->slots[s].full) {
+        pthread_cond_wait(&r->cond, &r->lock);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return &r->slots[s];
+}
+
+static void release_slot(struct chunk_reader *r, int s) {
+    pthread_mutex_lock(&r->lock);
+    r->slots[s].full = 0;
+    pthread_cond_broadcast(&r->cond);
+    pthread_mutex_unlock(&r->lock);
+}
+
+// writes the dataset file using the same rand() sequence as the in-memory versions, one buffer at a time so this also stays within the budget
+static int generate_data_file(const char *path, double *buf, long buf_points) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("out of core: open");
+        return -1;
+    }
+    for (long first = 0; first < NUM_POINTS; first += buf_points) {
+        long count = NUM_POINTS - first < buf_points ? NUM_POINTS - first : buf_points;
+        for (long i = 0; i < count * DIM; i++) {
+            buf[i] = (double)rand() / RAND_MAX;
+        }
+        if (pwrite_full(fd, buf, count * DIM * sizeof(double), first * DIM * sizeof(double)) != 0) {
+            perror("out of core: pwrite");
+            close(fd);
+            return -1;
+        }
+    }
+    close(fd);
+    return 0;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j, iter;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <data_file> [memory_budget_MB] [labels_file]\n", argv[0]);
+        return 1;
+    }
+    const char *data_path = argv[1];
+    long budget_mb = argc > 2 ? atol(argv[2]) : DEFAULT_BUDGET_MB;
+    const char *labels_path = argc > 3 ? argv[3] : NULL;
+
+// ===================================================================================================================================
+// Working out the chunk size from the memory budget. The two slots are the only thing that grows with the data size, everything else is K * DIM sized.
+
+    size_t bytes_per_point = DIM * sizeof(double) + (labels_path ? sizeof(label_t) : 0);
+    long chunk_points = (long)((budget_mb * 1024 * 1024) / (2 * bytes_per_point));
+    if (chunk_points < 1) chunk_points = 1;
+    if (chunk_points > NUM_POINTS) chunk_points = NUM_POINTS;
+    // with spilled labels we need at least 2 chunks, otherwise the reader would read the labels of chunk 0 for the next iteration before we wrote them back
+    if (labels_path && chunk_points > (NUM_POINTS + 1) / 2) chunk_points = (NUM_POINTS + 1) / 2;
+    long num_chunks = (NUM_POINTS + chunk_points - 1) / chunk_points;
+
+    struct chunk_reader *reader = calloc(1, sizeof(*reader));
+    reader->chunk_points = chunk_points;
+    reader->num_chunks = num_chunks;
+    reader->labels_fd = -1;
+    for (i = 0; i < 2; i++) {
+        reader->slots[i].points = malloc(chunk_points * DIM * sizeof(double));
+        reader->slots[i].labels = labels_path ? malloc(chunk_points * sizeof(label_t)) : NULL;
+    }
+
+    if (access(data_path, F_OK) != 0) {
+        printf("Generating %s ...\n", data_path);
+        if (generate_data_file(data_path, reader->slots[0].points, chunk_points) != 0) return 1;
+    }
+    reader->data_fd = open(data_path, O_RDONLY);
+    if (reader->data_fd < 0) {
+        perror("out of core: open");
+        return 1;
+    }
+    if (lseek(reader->data_fd, 0, SEEK_END) < (off_t)NUM_POINTS * DIM * (off_t)sizeof(double)) {
+        fprintf(stderr, "out of core: %s is smaller than NUM_POINTS * DIM doubles\n", data_path);
+        return 1;
+    }
+    if (labels_path) {
+        // a fresh zero filled file, same as calloc'ing the labels
+        reader->labels_fd = open(labels_path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (reader->labels_fd < 0 || ftruncate(reader->labels_fd, (off_t)NUM_POINTS * sizeof(label_t)) != 0) {
+            perror("out of core: labels file");
+            return 1;
+        }
+    }
+
+    // Initialize centroids (K x DIM) from the first K points of the file, same as the in-memory versions.
+    double centroids[K][DIM];
+    if (pread_full(reader->data_fd, centroids, sizeof(centroids), 0) != 0) {
+        perror("out of core: pread");
+        return 1;
+    }
+
+    pthread_mutex_init(&reader->lock, NULL);
+    pthread_cond_init(&reader->cond, NULL);
+    pthread_create(&reader->thread, NULL, chunk_reader_main, reader);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop. Because the data is only in memory one chunk at a time, the assignment and summation steps are fused: each chunk is assigned and added to the
+// partial sums in the same pass, then the slot goes back to the reader. The partial sum technique is the same as K_means_para.c.
+
+    double start_time = omp_get_wtime();
+
+    int changed = 1;
+    int s = 0;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {0};
+        int counts[K] = {0};
+
+        for (long c = 0; c < num_chunks; c++) {
+            struct chunk_slot *slot = wait_for_slot(reader, s);
+            const double *points = slot->points;
+            label_t *chunk_labels = slot->labels;
+            long count = slot->count;
+
+            #pragma omp parallel reduction(|:changed)
+            {
+                double local_new_centroids[K][DIM] = {0};
+                int local_counts[K] = {0};
+
+                #pragma omp for nowait
+                for (long p = 0; p < count; p++) {
+                    double *point = (double *)&points[p * DIM];
+                    int best_cluster = 0;
+                    double best_dist = distance_sq(point, centroids[0]);
+                    for (int k = 1; k < K; k++) {
+                        double d = distance_sq(point, centroids[k]);
+                        if (d < best_dist) {
+                            best_dist = d;
+                            best_cluster = k;
+                        }
+                    }
+                    if (chunk_labels != NULL && chunk_labels[p] != best_cluster) {
+                        chunk_labels[p] = (label_t)best_cluster;
+                        changed |= 1;
+                    }
+                    local_counts[best_cluster]++;
+                    for (int d = 0; d < DIM; d++) {
+                        local_new_centroids[best_cluster][d] += point[d];
+                    }
+                }
+
+                #pragma omp critical
+                {
+                    for (int k = 0; k < K; k++) {
+                        counts[k] += local_counts[k];
+                        for (int d = 0; d < DIM; d++) {
+                            new_centroids[k][d] += local_new_centroids[k][d];
+                        }
+                    }
+                }
+            }
+
+            // the updated labels go back to disk before the slot is handed back (the OS page cache makes this cheap)
+            if (chunk_labels != NULL && pwrite_full(reader->labels_fd, chunk_labels, count * sizeof(label_t), slot->first * sizeof(label_t)) != 0) {
+                perror("out of core: pwrite");
+                return 1;
+            }
+            release_slot(reader, s);
+            s ^= 1;
+        }
+
+        // Calculate the mean (average) for each centroid, and how far they moved for the no-labels convergence test.
+        double max_move = 0.0;
+        for (i = 0; i < K; i++) {
+            if (counts[i] > 0) {
+                double moved[DIM];
+                for (j = 0; j < DIM; j++) {
+                    moved[j] = centroids[i][j];
+                    centroids[i][j] = new_centroids[i][j] / counts[i];
+                }
+                double move = distance_sq(moved, centroids[i]);
+                if (move > max_move) max_move = move;
+            }
+        }
+        if (labels_path == NULL) {
+            changed = max_move > MOVE_TOLERANCE;
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+
+    pthread_mutex_lock(&reader->lock);
+    reader->quit = 1;
+    pthread_cond_broadcast(&reader->cond);
+    pthread_mutex_unlock(&reader->lock);
+    pthread_join(reader->thread, NULL);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations.\n", iter);
+    printf("Elapsed time (out of core): %f seconds\n", elapsed);
+    printf("Chunks: %ld of %ld points (%.1f MB of buffers)\n", num_chunks, chunk_points, 2.0 * chunk_points * bytes_per_point / (1024 * 1024));
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    close(reader->data_fd);
+    if (reader->labels_fd >= 0) close(reader->labels_fd);
+    pthread_mutex_destroy(&reader->lock);
+    pthread_cond_destroy(&reader->cond);
+    for (i = 0; i < 2; i++) {
+        free(reader->slots[i].points);
+        free(reader->slots[i].labels);
+    }
+    free(reader);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,390 @@
+// Same K-Means as K_means_para.c, but instead of only printf'ing the centroids and throwing the labels away, the results get written to a file:
+// the labels, the centroids, the squared distance of every point to its centroid and the size of every cluster.
+// printf-ing millions of labels would take longer than the clustering itself, so the main output is a compact binary file that is written in parallel:
+// the file gets its final size up front, then every thread pwrite()s its own slice of the labels / distances at its own offset.
+// usage: ./K_means_output <results.bin> [results.csv]
+//      results.csv -> optional text version (point,label,distance_sq per line), also formatted and written in parallel
+
+#define _XOPEN_SOURCE 700   // for pwrite
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define WRITE_CHUNK 65536       // entries per pwrite, small enough that the labels and distances make a few dozen chunks for the threads to share
+#define CSV_BLOCK 65536         // points per formatted CSV block
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Result file layout. All the sections start at a multiple of 64 bytes, their offsets are in the header so a reader can mmap the file and jump straight to them.
+//      header
+//      centroids   k * dim doubles
+//      sizes       k int64 (points per cluster)
+//      labels      num_points unsigned integers of label_bytes bytes each
+//      distances   num_points floats (squared distance to the own centroid, float is plenty for this and half the size)
+
+#define RESULT_MAGIC 0x53524D4BU    // "KMRS"
+#define RESULT_VERSION 1
+
+struct result_header {
+    uint32_t magic;
+    uint32_t version;
+    int64_t num_points;
+    int32_t dim;
+    int32_t k;
+    int32_t label_bytes;
+    int32_t distance_bytes;
+    int64_t centroids_offset;
+    int64_t sizes_offset;
+    int64_t labels_offset;
+    int64_t distances_offset;
+    int64_t file_size;
+};
+
+static int64_t align64(int64_t x) {
+    return (x + 63) & ~(int64_t)63;
+}
+
+// returns 0 or the errno of the write that failed. the threads write at the same time, so errno itself may belong to another thread by the time
+// anybody looks at it
+static int pwrite_full(int fd, const void *buf, size_t len, off_t offset) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t w = pwrite(fd, p, len, offset);
+        if (w < 0) return errno;
+        if (w == 0) return EIO;
+        p += w;
+        len -= w;
+        offset += w;
+    }
+    return 0;
+}
+
+static int write_results_binary(const char *path, double centroids[K][DIM], const int64_t sizes[K], const label_t *labels, const float *distances) {
+    struct result_header h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RESULT_MAGIC;
+    h.version = RESULT_VERSION;
+    h.num_points = NUM_POINTS;
+    h.dim = DIM;
+    h.k = K;
+    h.label_bytes = sizeof(label_t);
+    h.distance_bytes = sizeof(float);
+    h.centroids_offset = align64(sizeof(h));
+    h.sizes_offset = align64(h.centroids_offset + sizeof(double) * K * DIM);
+    h.labels_offset = align64(h.sizes_offset + sizeof(int64_t) * K);
+    h.distances_offset = align64(h.labels_offset + (int64_t)sizeof(label_t) * NUM_POINTS);
+    h.file_size = h.distances_offset + (int64_t)sizeof(float) * NUM_POINTS;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, h.file_size) != 0) {
+        perror("output: open");
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    int error = pwrite_full(fd, &h, sizeof(h), 0);
+    if (error == 0) error = pwrite_full(fd, centroids, sizeof(double) * K * DIM, h.centroids_offset);
+    if (error == 0) error = pwrite_full(fd, sizes, sizeof(int64_t) * K, h.sizes_offset);
+
+    // the big sections: every chunk goes to its own offset so the threads never have to wait for each other.
+    // the first error wins, that is the one that gets reported
+    const long num_chunks = (NUM_POINTS + WRITE_CHUNK - 1) / WRITE_CHUNK;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long c = 0; c < 2 * num_chunks; c++) {
+        long chunk = c % num_chunks;
+        long first = chunk * WRITE_CHUNK;
+        long count = NUM_POINTS - first < WRITE_CHUNK ? NUM_POINTS - first : WRITE_CHUNK;
+        int chunk_error;
+        if (c < num_chunks) {
+            chunk_error = pwrite_full(fd, labels + first, count * sizeof(label_t), h.labels_offset + first * (off_t)sizeof(label_t));
+        } else {
+            chunk_error = pwrite_full(fd, distances + first, count * sizeof(float), h.distances_offset + first * (off_t)sizeof(float));
+        }
+        if (chunk_error != 0) {
+            #pragma omp critical(output_error)
+            if (error == 0) error = chunk_error;
+        }
+    }
+    if (close(fd) != 0 && error == 0) error = errno;
+    if (error != 0) {
+        fprintf(stderr, "output: pwrite: %s\n", strerror(error));
+        return -1;
+    }
+    return 0;
+}
+
+// writes an unsigned number in decimal and returns how many characters it took (a lot faster than snprintf for the labels and indices)
+static int format_uint(char *out, unsigned long v) {
+    char tmp[24];
+    int n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v > 0);
+    for (int i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+// CSV in two passes: every block of points is formatted into its own buffer in parallel, then a prefix sum over the buffer sizes gives each block its offset
+// in the file and the blocks are written in parallel too.
+static int write_results_csv(const char *path, const label_t *labels, const float *distances) {
+    const long num_blocks = (NUM_POINTS + CSV_BLOCK - 1) / CSV_BLOCK;
+    char **blocks = malloc(num_blocks * sizeof(char *));
+    off_t *offsets = malloc((num_blocks + 1) * sizeof(off_t));
+    const char *header_line = "point,label,distance_sq\n";
+    offsets[0] = strlen(header_line);
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long b = 0; b < num_blocks; b++) {
+        long first = b * CSV_BLOCK;
+        long end = first + CSV_BLOCK < NUM_POINTS ? first + CSV_BLOCK : NUM_POINTS;
+        char *buf = malloc((end - first) * 64);    // index (<= 20) + label (<= 10) + distance (<= 16) + separators fits easily
+        char *p = buf;
+        for (long i = first; i < end; i++) {
+            p += format_uint(p, i);
+            *p++ = ',';
+            p += format_uint(p, labels[i]);
+            *p++ = ',';
+            p += snprintf(p, 24, "%.7g", distances[i]);
+            *p++ = '\n';
+        }
+        blocks[b] = buf;
+        offsets[b + 1] = p - buf;   // just the size for now
+    }
+    for (long b = 0; b < num_blocks; b++) {
+        offsets[b + 1] += offsets[b];
+    }
+
+    // same first error wins as in write_results_binary
+    int error = 0;
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, offsets[num_blocks]) != 0) {
+        error = errno;
+    } else if ((error = pwrite_full(fd, header_line, offsets[0], 0)) == 0) {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (long b = 0; b < num_blocks; b++) {
+            int block_error = pwrite_full(fd, blocks[b], offsets[b + 1] - offsets[b], offsets[b]);
+            if (block_error != 0) {
+                #pragma omp critical(output_error)
+                if (error == 0) error = block_error;
+            }
+        }
+    }
+    if (fd >= 0 && close(fd) != 0 && error == 0) error = errno;
+    if (error != 0) fprintf(stderr, "output: csv: %s\n", strerror(error));
+
+    for (long b = 0; b < num_blocks; b++) {
+        free(blocks[b]);
+    }
+    free(blocks);
+    free(offsets);
+    return error != 0 ? -1 : 0;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j, iter;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <results.bin> [results.csv]\n", argv[0]);
+        return 1;
+    }
+    const char *bin_path = argv[1];
+    const char *csv_path = argc > 2 ? argv[2] : NULL;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+    float *distances = malloc(NUM_POINTS * sizeof(float));
+
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop, same as K_means_para.c (assignment and summation fused into one pass)
+
+    double start_time = omp_get_wtime();
+
+    int changed = 1;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {{0}};
+        int counts[K] = {0};
+
+        #pragma omp parallel reduction(|:changed)
+        {
+            double local_new_centroids[K][DIM] = {{0}};
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int best_cluster = 0;
+                double best_dist = distance_sq(data[i], centroids[0]);
+                for (int j = 1; j < K; j++) {
+                    double d = distance_sq(data[i], centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed |= 1;
+                }
+                local_counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[best_cluster][d] += data[i][d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (i = 0; i < K; i++) {
+            if (counts[i] > 0) {
+                for (j = 0; j < DIM; j++) {
+                    centroids[i][j] = new_centroids[i][j] / counts[i];
+                }
+            }
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+
+    // distances to the final centroids and the cluster sizes, for the output
+    int64_t sizes[K] = {0};
+    #pragma omp parallel
+    {
+        int64_t local_sizes[K] = {0};
+        #pragma omp for nowait
+        for (int i = 0; i < NUM_POINTS; i++) {
+            distances[i] = (float)distance_sq(data[i], centroids[labels[i]]);
+            local_sizes[labels[i]]++;
+        }
+        #pragma omp critical
+        {
+            for (int c = 0; c < K; c++) {
+                sizes[c] += local_sizes[c];
+            }
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Writing the results
+
+    double write_start = omp_get_wtime();
+    int failed = write_results_binary(bin_path, centroids, sizes, labels, distances) != 0;
+    double write_time = omp_get_wtime() - write_start;
+
+    double csv_time = 0.0;
+    if (csv_path && !failed) {
+        double csv_start = omp_get_wtime();
+        failed = write_results_csv(csv_path, labels, distances) != 0;
+        csv_time = omp_get_wtime() - csv_start;
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations.\n", iter);
+    printf("Elapsed time (parallel): %f seconds\n", elapsed);
+    printf("Binary results written to %s in %f seconds\n", bin_path, write_time);
+    if (csv_path) printf("CSV results written to %s in %f seconds\n", csv_path, csv_time);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d (%ld points): ", i, (long)sizes[i]);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+    free(distances);
+
+    return failed;
+// ===================================================================================================================================
+
+
+}
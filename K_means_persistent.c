@@ -0,0 +1,193 @@
+// Same code as the K_means_para.c file will be used here but with only ONE parallel region for the whole run instead of two per iteration.
+// In K_means_para.c every iteration opens a parallel for (assignment) and a parallel block (summation) and then does the mean calculation serially, so 100 iterations
+// means 200 times the threads get woken up and put to sleep again (fork/join). Here the threads are created once, they all run the iteration loop together,
+// and the phases of an iteration are separated by barriers instead:
+//      1. assign + accumulate into this thread's partial sums       (omp for nowait, then a barrier)
+//      2. add up the partials and divide, in parallel across K        (omp for, implicit barrier)
+//      3. one thread decides if we converged                          (omp single, implicit barrier)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// Each thread's partial sums. In K_means_para.c these were local arrays merged in a critical section, here they have to be visible to the other threads
+// since the merge is done in parallel across K. The padding keeps two threads from writing into the same cache line.
+struct partial_sums {
+    double sums[K][DIM];
+    int counts[K];
+    int changed;
+    char pad[64];
+};
+
+// ===================================================================================================================================
+
+
+
+int main() {
+
+    int i, j, iter;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+
+    struct partial_sums *partials = malloc(omp_get_max_threads() * sizeof(struct partial_sums));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop. iter and changed are shared and only ever written inside the omp single, every thread reads them after the barrier at the end of that single,
+// so all threads always agree on whether to do another iteration.
+
+    double start_time = omp_get_wtime();
+
+    int changed = 1;
+    iter = 0;
+
+    #pragma omp parallel
+    {
+        int num_threads = omp_get_num_threads();
+        struct partial_sums *mine = &partials[omp_get_thread_num()];
+
+        while (iter < MAX_ITER && changed) {
+            memset(mine, 0, sizeof(*mine));
+
+            // Phase 1: assignment and summation in the same pass. static schedule so every thread gets the same points each iteration (they stay in its cache).
+            #pragma omp for schedule(static) nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int best_cluster = 0;
+                double best_dist = distance_sq(data[i], centroids[0]);
+                for (int j = 1; j < K; j++) {
+                    double d = distance_sq(data[i], centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    mine->changed = 1;
+                }
+                mine->counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    mine->sums[best_cluster][d] += data[i][d];
+                }
+            }
+            // nobody may touch the centroids before every thread is done reading them
+            #pragma omp barrier
+
+            // Phase 2: reduce the partials and compute the mean, one cluster per loop iteration so this is parallel across K
+            #pragma omp for schedule(static)
+            for (int c = 0; c < K; c++) {
+                double sum[DIM] = {0};
+                int count = 0;
+                for (int t = 0; t < num_threads; t++) {
+                    count += partials[t].counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        sum[d] += partials[t].sums[c][d];
+                    }
+                }
+                if (count > 0) {  // Avoid division by zero.
+                    for (int d = 0; d < DIM; d++) {
+                        centroids[c][d] = sum[d] / count;
+                    }
+                }
+            }
+
+            // Phase 3: a single thread decides about convergence
+            #pragma omp single
+            {
+                changed = 0;
+                for (int t = 0; t < num_threads; t++) {
+                    changed |= partials[t].changed;
+                }
+                iter++;
+            }
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations.\n", iter);
+    printf("Elapsed time (persistent region): %f seconds\n", elapsed);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    free(partials);
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
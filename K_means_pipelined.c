@@ -0,0 +1,231 @@
+// Same K-Means as K_means_para.c but the data generation is overlapped with the first iteration.
+// Normally all NUM_POINTS points have to be generated (or loaded) before start_time is even taken. Here a producer thread fills the data in chunks and
+// publishes how many points are ready, and the first iteration's assignment + summation works on each chunk as soon as it is there.
+// The starting centroids are the first K points, so they are available as soon as the first chunk is done.
+// usage: ./K_means_pipelined [serial]
+//      serial -> generate everything first and then cluster, like the other files (for comparison)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define CHUNK 16384         // points the producer publishes at once
+
+#if CHUNK < K
+#error "the first chunk has to contain the K starting centroids"
+#endif
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The producer. It generates the same rand() points in the same order as every other file, a chunk at a time, and after each chunk moves "ready" forward.
+// the release store on ready makes sure a consumer that sees the new value also sees the points that were written before it.
+
+struct producer {
+    double **data;
+    atomic_long ready;      // points [0, ready) can be used
+};
+
+static void *producer_main(void *arg) {
+    struct producer *p = arg;
+    for (long first = 0; first < NUM_POINTS; first += CHUNK) {
+        long end = first + CHUNK < NUM_POINTS ? first + CHUNK : NUM_POINTS;
+        for (long i = first; i < end; i++) {
+            for (int j = 0; j < DIM; j++) {
+                p->data[i][j] = (double)rand() / RAND_MAX;
+            }
+        }
+        atomic_store_explicit(&p->ready, end, memory_order_release);
+    }
+    return NULL;
+}
+
+static void wait_until_ready(struct producer *p, long end) {
+    while (atomic_load_explicit(&p->ready, memory_order_acquire) < end) {
+        sched_yield();  // the producer might be sharing our core
+    }
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j, iter;
+    int serial = argc > 1 && strcmp(argv[1], "serial") == 0;
+
+    // this time the clock starts before the data exists, since time to first result is what we are after
+    double start_time = omp_get_wtime();
+
+// ===================================================================================================================================
+// Allocating the data. the points are one block (so the setup is one malloc instead of a million) with the usual double **data on top of it.
+
+    double *storage = malloc((size_t)NUM_POINTS * DIM * sizeof(double));
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = &storage[(size_t)i * DIM];
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    struct producer prod;
+    prod.data = data;
+    atomic_init(&prod.ready, 0);
+    pthread_t producer_thread;
+    pthread_create(&producer_thread, NULL, producer_main, &prod);
+    if (serial) {
+        pthread_join(producer_thread, NULL);
+    }
+
+    // the starting centroids only need the first chunk
+    wait_until_ready(&prod, K);
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop. Assignment and summation are done in the same pass over a chunk, with the partial sums of K_means_para.c.
+// In iteration 0 every chunk first waits for the producer. dynamic hands the chunks out in order, so the threads follow right behind the producer.
+
+    double first_iteration_time = 0.0;
+    int changed = 1;
+    const long num_chunks = (NUM_POINTS + CHUNK - 1) / CHUNK;
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        int pipelined = iter == 0 && !serial;
+        double new_centroids[K][DIM] = {{0}};
+        int counts[K] = {0};
+
+        #pragma omp parallel reduction(|:changed)
+        {
+            double local_new_centroids[K][DIM] = {{0}};
+            int local_counts[K] = {0};
+
+            #pragma omp for schedule(dynamic, 1) nowait
+            for (long c = 0; c < num_chunks; c++) {
+                long first = c * CHUNK;
+                long end = first + CHUNK < NUM_POINTS ? first + CHUNK : NUM_POINTS;
+                if (pipelined) wait_until_ready(&prod, end);
+
+                for (long i = first; i < end; i++) {
+                    int best_cluster = 0;
+                    double best_dist = distance_sq(data[i], centroids[0]);
+                    for (int j = 1; j < K; j++) {
+                        double d = distance_sq(data[i], centroids[j]);
+                        if (d < best_dist) {
+                            best_dist = d;
+                            best_cluster = j;
+                        }
+                    }
+                    if (labels[i] != best_cluster) {
+                        labels[i] = (label_t)best_cluster;
+                        changed |= 1;
+                    }
+                    local_counts[best_cluster]++;
+                    for (int d = 0; d < DIM; d++) {
+                        local_new_centroids[best_cluster][d] += data[i][d];
+                    }
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (i = 0; i < K; i++) {
+            if (counts[i] > 0) {
+                for (j = 0; j < DIM; j++) {
+                    centroids[i][j] = new_centroids[i][j] / counts[i];
+                }
+            }
+        }
+        if (iter == 0) {
+            first_iteration_time = omp_get_wtime() - start_time;
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+    if (!serial) {
+        pthread_join(producer_thread, NULL);    // already finished: iteration 0 waited for every chunk
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations.\n", iter);
+    printf("Time to first iteration (%s): %f seconds\n", serial ? "serial" : "pipelined", first_iteration_time);
+    printf("Elapsed time including generation: %f seconds\n", elapsed);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory. two frees instead of one per point
+    free(storage);
+    free(data);
+    free(labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,297 @@
+// Two stage assignment for big models: most of the K centroids are obviously not the nearest one, and finding that out doesn't need 8 byte doubles.
+// Stage 1 compares the point with every centroid using small integer copies of both (8 or 16 bits per value, see QUANT_BITS), which is 8x / 4x less
+// memory to stream and integer math the compiler can vectorize. Stage 2 computes the exact distance_sq, but only for the centroids stage 1 could not rule out.
+// Which centroids are "ruled out" is not a guess (like keeping the top 4): the rounding error of the quantization is bounded, so we know how far off
+// every approximate distance can be, and only centroids that provably can't be the nearest are dropped. The labels are the same as the exact path.
+// The program runs both and compares.
+// compile with -lm
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// a "large model" instead of the usual 2D / K = 3 setup
+
+#define NUM_POINTS 100000   // points
+#define DIM 32              // dimensions per point
+#define K 1024              // Number of clusters
+#define MAX_ITER 10         // Maximum iterations
+#define SPREAD 0.02         // the points are generated in K blobs of this size, uniform data in 32D has no clusters to find
+
+#define QUANT_BITS 8        // 8 or 16
+
+#if QUANT_BITS == 8
+typedef uint8_t quant_t;
+#define QMAX 255
+#else
+typedef uint16_t quant_t;
+#define QMAX 4095           // not the full 16 bits: this way the squared distances still fit in 32 bits (and the filter is already near perfect)
+#endif
+typedef int32_t qdist_t;    // 32 bit sums vectorize a lot better than 64 bit ones
+
+#if QMAX * QMAX * DIM > 2147483647
+#error "quantized squared distances don't fit in 32 bits, lower QMAX"
+#endif
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Quantization. every value v in [lo, hi] becomes round((v - lo) / step) with step = (hi - lo) / QMAX, so the rounding error is at most half a step
+// per value. Points and centroids use the same lo and step (the centroids are means of points, so they stay inside [lo, hi]).
+//
+// In step units, the true distance between x and c and the distance between their quantized copies differ by at most ||error of x - error of c||,
+// and every coordinate of that is at most 1, so by at most sqrt(DIM). If the smallest quantized distance is m, the nearest centroid is at most
+// m + sqrt(DIM) away, and a centroid whose quantized distance is more than m + 2 * sqrt(DIM) is further than that for sure.
+
+struct quantizer {
+    double lo, step;
+};
+
+static void quantize(const struct quantizer *q, const double *values, quant_t *out, long n) {
+    #pragma omp parallel for
+    for (long i = 0; i < n; i++) {
+        double v = (values[i] - q->lo) / q->step + 0.5;
+        if (v < 0.0) v = 0.0;
+        if (v > QMAX) v = QMAX;
+        out[i] = (quant_t)v;
+    }
+}
+
+static qdist_t quant_distance_sq(const quant_t *a, const quant_t *b) {
+    qdist_t sum = 0;
+    for (int d = 0; d < DIM; d++) {
+        qdist_t diff = (qdist_t)a[d] - (qdist_t)b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// the largest quantized squared distance a centroid can have and still be the nearest one, given the smallest quantized distance min_qdist.
+// the 1e-6 is slack for the rounding of the doubles themselves
+static double candidate_threshold(qdist_t min_qdist) {
+    double r = sqrt((double)min_qdist) + 2.0 * sqrt((double)DIM) * (1.0 + 1e-6) + 1e-6;
+    return r * r;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop. quantized = 0 is the exact assignment of K_means_para.c, quantized = 1 the two stage one. returns the number of iterations
+
+static long total_candidates;   // exact distances computed in stage 2, for the stats
+
+static int kmeans(double *points, quant_t *qpoints, const struct quantizer *q, double *centroids, label_t *labels, int quantized) {
+    int iter;
+    long changed = 1;
+    double (*sums)[DIM] = malloc(K * sizeof(*sums));
+    long *counts = malloc(K * sizeof(long));
+    quant_t *qcentroids = malloc((size_t)K * DIM * sizeof(quant_t));
+
+    memset(labels, 0, NUM_POINTS * sizeof(label_t));
+    memcpy(centroids, points, (size_t)K * DIM * sizeof(double));   // the first K points, like always
+    total_candidates = 0;
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        memset(sums, 0, K * sizeof(*sums));
+        memset(counts, 0, K * sizeof(long));
+        if (quantized) {
+            quantize(q, centroids, qcentroids, (long)K * DIM);     // K * DIM values, nothing next to the points
+        }
+        long candidates = 0;
+
+        #pragma omp parallel reduction(+:changed, candidates)
+        {
+            double (*local_sums)[DIM] = calloc(K, sizeof(*local_sums));
+            long *local_counts = calloc(K, sizeof(long));
+            qdist_t *qdist = malloc(K * sizeof(qdist_t));
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                double *point = &points[(size_t)i * DIM];
+                int best_cluster = 0;
+                double best_dist;
+
+                if (quantized) {
+                    // stage 1: approximate distances to every centroid
+                    const quant_t *qpoint = &qpoints[(size_t)i * DIM];
+                    qdist_t min_qdist = quant_distance_sq(qpoint, &qcentroids[0]);
+                    qdist[0] = min_qdist;
+                    for (int j = 1; j < K; j++) {
+                        qdist[j] = quant_distance_sq(qpoint, &qcentroids[(size_t)j * DIM]);
+                        if (qdist[j] < min_qdist) min_qdist = qdist[j];
+                    }
+                    // stage 2: exact distances for the ones that are left, in increasing j with strict < just like the exact loop, so ties go the same way
+                    double threshold = candidate_threshold(min_qdist);
+                    best_dist = INFINITY;
+                    for (int j = 0; j < K; j++) {
+                        if ((double)qdist[j] > threshold) continue;
+                        candidates++;
+                        double d = distance_sq(point, &centroids[(size_t)j * DIM]);
+                        if (d < best_dist) {
+                            best_dist = d;
+                            best_cluster = j;
+                        }
+                    }
+                } else {
+                    best_dist = distance_sq(point, &centroids[0]);
+                    for (int j = 1; j < K; j++) {
+                        double d = distance_sq(point, &centroids[(size_t)j * DIM]);
+                        if (d < best_dist) {
+                            best_dist = d;
+                            best_cluster = j;
+                        }
+                    }
+                }
+
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed++;
+                }
+                local_counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_sums[best_cluster][d] += point[d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        sums[c][d] += local_sums[c][d];
+                    }
+                }
+            }
+            free(local_sums);
+            free(local_counts);
+            free(qdist);
+        }
+        total_candidates += candidates;
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[(size_t)c * DIM + d] = sums[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    free(sums);
+    free(counts);
+    free(qcentroids);
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main() {
+
+    long i;
+
+// ===================================================================================================================================
+// Creating the data: K random blob centers, every point is a random center plus up to SPREAD / 2 of noise per coordinate
+
+    double *blob_centers = malloc((size_t)K * DIM * sizeof(double));
+    for (i = 0; i < (long)K * DIM; i++) {
+        blob_centers[i] = (double)rand() / RAND_MAX;
+    }
+    double *points = malloc((size_t)NUM_POINTS * DIM * sizeof(double));
+    for (i = 0; i < NUM_POINTS; i++) {
+        double *center = &blob_centers[(size_t)(rand() % K) * DIM];
+        for (int d = 0; d < DIM; d++) {
+            points[i * DIM + d] = center[d] + SPREAD * ((double)rand() / RAND_MAX - 0.5);
+        }
+    }
+
+    struct quantizer q;
+    double lo = points[0], hi = points[0];
+    for (i = 1; i < (long)NUM_POINTS * DIM; i++) {
+        if (points[i] < lo) lo = points[i];
+        if (points[i] > hi) hi = points[i];
+    }
+    q.lo = lo;
+    q.step = (hi - lo) / QMAX;
+    quant_t *qpoints = malloc((size_t)NUM_POINTS * DIM * sizeof(quant_t));
+    quantize(&q, points, qpoints, (long)NUM_POINTS * DIM);     // once, the points never change
+
+    label_t *labels = malloc(NUM_POINTS * sizeof(label_t));
+    label_t *quantized_labels = malloc(NUM_POINTS * sizeof(label_t));
+    double *centroids = malloc((size_t)K * DIM * sizeof(double));
+    double *quantized_centroids = malloc((size_t)K * DIM * sizeof(double));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    double start_time = omp_get_wtime();
+    int exact_iterations = kmeans(points, qpoints, &q, centroids, labels, 0);
+    double exact_time = omp_get_wtime() - start_time;
+
+    start_time = omp_get_wtime();
+    int quantized_iterations = kmeans(points, qpoints, &q, quantized_centroids, quantized_labels, 1);
+    double quantized_time = omp_get_wtime() - start_time;
+
+    long mismatches = 0;
+    for (i = 0; i < NUM_POINTS; i++) {
+        mismatches += labels[i] != quantized_labels[i];
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("Elapsed time (exact):          %f seconds, %d iterations\n", exact_time, exact_iterations);
+    printf("Elapsed time (%2d bit filter):  %f seconds, %d iterations, %.2f exact distances per point instead of %d\n",
+           QUANT_BITS, quantized_time, quantized_iterations, (double)total_candidates / ((double)NUM_POINTS * quantized_iterations), K);
+    printf("Labels that differ: %ld, centroids identical: %s\n", mismatches,
+           memcmp(centroids, quantized_centroids, (size_t)K * DIM * sizeof(double)) == 0 ? "yes" : "no");
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    free(blob_centers);
+    free(points);
+    free(qpoints);
+    free(labels);
+    free(quantized_labels);
+    free(centroids);
+    free(quantized_centroids);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,277 @@
+// Same K-Means as K_means_para.c but with a reduction that gives the same bits no matter how many threads there are.
+// In K_means_para.c every thread sums its own range of points and the partial sums get added up in the critical section in whatever order the threads
+// arrive. Floating point addition isn't associative, so a different thread count (different ranges) or just a different arrival order gives slightly
+// different centroids, which can flip a border point and change the iteration count.
+// Here the points are cut into blocks of BLOCK points, fixed no matter how many threads there are. Each block is summed in point order by whichever
+// thread gets it, into its own slot, and then the block sums are added up pairwise in a tree whose shape only depends on the number of blocks.
+// The program runs the normal and the reproducible version with several thread counts and checks which ones come out bit for bit the same.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define BLOCK 4096          // points per block, part of the result: changing it changes the rounding (but then again identically on every run)
+#define NUM_BLOCKS ((NUM_POINTS + BLOCK - 1) / BLOCK)
+#define TIMING_RUNS 5       // runs of each version at the default thread count for the overhead, the fastest one counts
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// one block's sums
+struct block_sums {
+    double sums[K][DIM];
+    long counts[K];
+};
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop, returns the number of iterations. reproducible = 0 is K_means_para.c, 1 is the blocked version.
+
+static int nearest(double *point, double centroids[K][DIM]) {
+    int best_cluster = 0;
+    double best_dist = distance_sq(point, centroids[0]);
+    for (int j = 1; j < K; j++) {
+        double d = distance_sq(point, centroids[j]);
+        if (d < best_dist) {
+            best_dist = d;
+            best_cluster = j;
+        }
+    }
+    return best_cluster;
+}
+
+static int kmeans(double **data, double centroids[K][DIM], label_t *labels, struct block_sums *blocks, int reproducible) {
+    int iter;
+    int changed = 1;
+    memset(labels, 0, NUM_POINTS * sizeof(label_t));
+    for (int c = 0; c < K; c++) {
+        for (int d = 0; d < DIM; d++) {
+            centroids[c][d] = data[c][d];
+        }
+    }
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {{0}};
+        long counts[K] = {0};
+
+        if (!reproducible) {
+            #pragma omp parallel reduction(|:changed)
+            {
+                double local_new_centroids[K][DIM] = {{0}};
+                long local_counts[K] = {0};
+
+                #pragma omp for nowait
+                for (int i = 0; i < NUM_POINTS; i++) {
+                    int best_cluster = nearest(data[i], centroids);
+                    if (labels[i] != best_cluster) {
+                        labels[i] = (label_t)best_cluster;
+                        changed |= 1;
+                    }
+                    local_counts[best_cluster]++;
+                    for (int d = 0; d < DIM; d++) {
+                        local_new_centroids[best_cluster][d] += data[i][d];
+                    }
+                }
+
+                #pragma omp critical
+                {
+                    for (int c = 0; c < K; c++) {
+                        counts[c] += local_counts[c];
+                        for (int d = 0; d < DIM; d++) {
+                            new_centroids[c][d] += local_new_centroids[c][d];
+                        }
+                    }
+                }
+            }
+        } else {
+            // every block summed on its own, in point order. which thread does which block doesn't matter any more
+            #pragma omp parallel for schedule(static) reduction(|:changed)
+            for (int b = 0; b < NUM_BLOCKS; b++) {
+                struct block_sums *mine = &blocks[b];
+                memset(mine, 0, sizeof(*mine));
+                int end = (b + 1) * BLOCK < NUM_POINTS ? (b + 1) * BLOCK : NUM_POINTS;
+                for (int i = b * BLOCK; i < end; i++) {
+                    int best_cluster = nearest(data[i], centroids);
+                    if (labels[i] != best_cluster) {
+                        labels[i] = (label_t)best_cluster;
+                        changed |= 1;
+                    }
+                    mine->counts[best_cluster]++;
+                    for (int d = 0; d < DIM; d++) {
+                        mine->sums[best_cluster][d] += data[i][d];
+                    }
+                }
+            }
+
+            // pairwise tree over the blocks: block b gets block b + stride added for stride = 1, 2, 4, ... so it is always the same additions
+            // in the same order. NUM_BLOCKS * K * DIM doubles is tiny, so this runs on one thread, a parallel region per level would cost more
+            for (int stride = 1; stride < NUM_BLOCKS; stride *= 2) {
+                for (int b = 0; b + stride < NUM_BLOCKS; b += 2 * stride) {
+                    for (int c = 0; c < K; c++) {
+                        blocks[b].counts[c] += blocks[b + stride].counts[c];
+                        for (int d = 0; d < DIM; d++) {
+                            blocks[b].sums[c][d] += blocks[b + stride].sums[c][d];
+                        }
+                    }
+                }
+            }
+            memcpy(new_centroids, blocks[0].sums, sizeof(new_centroids));
+            memcpy(counts, blocks[0].counts, sizeof(counts));
+        }
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main() {
+
+    int i, j;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+    struct block_sums *blocks = malloc(NUM_BLOCKS * sizeof(struct block_sums));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Both versions with 1, 2, 3, ... threads up to the default (at least 4, so there is something to compare even on a small machine).
+// the results of the first thread count are the reference the others are compared to
+
+    int default_threads = omp_get_max_threads();
+    int max_threads = default_threads > 4 ? default_threads : 4;
+    int thread_counts[] = {1, 2, 3, max_threads};
+    const int num_counts = sizeof(thread_counts) / sizeof(thread_counts[0]);
+
+    double reference[2][K][DIM];
+    int all_identical[2] = {1, 1};
+
+    for (int reproducible = 0; reproducible <= 1; reproducible++) {
+        printf("%s:\n", reproducible ? "Reproducible (blocked + pairwise tree)" : "Fast (critical section merge)");
+        for (int t = 0; t < num_counts; t++) {
+            omp_set_num_threads(thread_counts[t]);
+            double centroids[K][DIM];
+            double start_time = omp_get_wtime();
+            int iter = kmeans(data, centroids, labels, blocks, reproducible);
+            double elapsed = omp_get_wtime() - start_time;
+
+            if (t == 0) {
+                memcpy(reference[reproducible], centroids, sizeof(centroids));
+            }
+            int identical = memcmp(reference[reproducible], centroids, sizeof(centroids)) == 0;
+            all_identical[reproducible] &= identical;
+            printf("  %2d threads: %d iterations, %f seconds, centroid 0 =", thread_counts[t], iter, elapsed);
+            for (j = 0; j < DIM; j++) {
+                printf(" %.17g", centroids[0][j]);
+            }
+            printf("%s\n", identical ? "" : "  (differs from 1 thread)");
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The overhead, at the default thread count only (the sweep above mixes in thread counts the program would never run with).
+// The two versions take turns so a slow phase of the machine hits both, and the fastest of TIMING_RUNS runs counts. Per iteration, because the
+// different rounding can give the two versions a different number of iterations.
+
+    omp_set_num_threads(default_threads);
+    double best_time[2] = {0.0, 0.0};
+    for (int run = 0; run < TIMING_RUNS; run++) {
+        for (int reproducible = 0; reproducible <= 1; reproducible++) {
+            double centroids[K][DIM];
+            double start_time = omp_get_wtime();
+            int iter = kmeans(data, centroids, labels, blocks, reproducible);
+            double per_iteration = (omp_get_wtime() - start_time) / iter;
+            if (run == 0 || per_iteration < best_time[reproducible]) best_time[reproducible] = per_iteration;
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("Bitwise identical across thread counts: fast %s, reproducible %s\n", all_identical[0] ? "yes" : "no", all_identical[1] ? "yes" : "no");
+    printf("Time per iteration at %d threads (best of %d runs): fast %f seconds, reproducible %f seconds\n", default_threads, TIMING_RUNS,
+           best_time[0], best_time[1]);
+    printf("Overhead of the reproducible reduction: %.1f%%\n", 100.0 * (best_time[1] / best_time[0] - 1.0));
+    printf("Final centroids (reproducible):\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", reference[1][i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+    free(blocks);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,276 @@
+// K-Means for sparse, high dimensional data (think bag of words / hashed features: tens of thousands of dimensions but only ~1% of them non zero per point).
+// Storing that as double **data like the other files would mean NUM_POINTS x DIM doubles that are almost all 0, so here the points are stored in CSR format
+// (compressed sparse rows) and the distance is computed without ever touching the zeros:
+//      ||x - c||^2 = ||x||^2 - 2 x.c + ||c||^2
+// ||x||^2 is the same for every centroid so it doesn't matter for the comparison, ||c||^2 is computed once per iteration, and x.c only loops over the non zeros of x.
+// usage: ./K_means_sparse [spherical]
+//      spherical -> cosine similarity instead of Euclidean distance (spherical K-Means): points and centroids are normalized to length 1 and the update step
+//                   uses the normalized mean
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+#define NUM_POINTS 100000    // fewer points than the dense versions, each one is a lot bigger
+#define DIM 20000           // number of features
+#define NNZ_PER_POINT 200   // non zeros per point (1% of DIM)
+#define K 16                // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// CSR format: the non zeros of point i are col_idx[row_ptr[i] .. row_ptr[i+1]-1] with values values[row_ptr[i] .. row_ptr[i+1]-1]
+struct csr_matrix {
+    long *row_ptr;          // NUM_POINTS + 1 entries
+    int *col_idx;
+    double *values;
+    long nnz;
+};
+
+// dot products of sparse row i with all K centroids at once, this is the only place the points get read in the assignment step.
+// the centroids are passed transposed (DIM x K) so each non zero reads K doubles that sit next to each other, instead of K reads that are DIM doubles apart
+void sparse_dot_all(const struct csr_matrix *m, int i, const double *centroids_t, double dots[K]) {
+    for (int c = 0; c < K; c++) {
+        dots[c] = 0.0;
+    }
+    for (long p = m->row_ptr[i]; p < m->row_ptr[i + 1]; p++) {
+        double v = m->values[p];
+        const double *row = centroids_t + (size_t)m->col_idx[p] * K;
+        for (int c = 0; c < K; c++) {
+            dots[c] += v * row[c];
+        }
+    }
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Generating the data. To give the clustering something to find, every point picks one of K "topics" and most of its non zeros come from that topic's block of features.
+
+static struct csr_matrix *generate_sparse_data(void) {
+    struct csr_matrix *m = malloc(sizeof(*m));
+    m->nnz = (long)NUM_POINTS * NNZ_PER_POINT;
+    m->row_ptr = malloc((NUM_POINTS + 1) * sizeof(long));
+    m->col_idx = malloc(m->nnz * sizeof(int));
+    m->values = malloc(m->nnz * sizeof(double));
+
+    int block = DIM / K;
+    long p = 0;
+    for (int i = 0; i < NUM_POINTS; i++) {
+        m->row_ptr[i] = p;
+        int topic = rand() % K;
+        for (int n = 0; n < NNZ_PER_POINT; n++) {
+            // 3 out of 4 features from the topic's block, the rest from anywhere. duplicate columns are allowed, they just add up in the dot product
+            int col = (rand() % 4 != 0) ? topic * block + rand() % block : rand() % DIM;
+            m->col_idx[p] = col;
+            m->values[p] = (double)rand() / RAND_MAX;
+            p++;
+        }
+    }
+    m->row_ptr[NUM_POINTS] = p;
+    return m;
+}
+
+static void normalize_rows(struct csr_matrix *m) {
+    #pragma omp parallel for
+    for (int i = 0; i < NUM_POINTS; i++) {
+        double norm_sq = 0.0;
+        for (long p = m->row_ptr[i]; p < m->row_ptr[i + 1]; p++) {
+            norm_sq += m->values[p] * m->values[p];
+        }
+        if (norm_sq > 0.0) {
+            double inv = 1.0 / sqrt(norm_sq);
+            for (long p = m->row_ptr[i]; p < m->row_ptr[i + 1]; p++) {
+                m->values[p] *= inv;
+            }
+        }
+    }
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j, iter;
+    int spherical = argc > 1 && strcmp(argv[1], "spherical") == 0;
+
+// ===================================================================================================================================
+// Loading/creating the data. The centroids are dense (K x DIM) since the mean of many sparse points isn't sparse anymore, that is still way smaller than the data.
+
+    struct csr_matrix *data = generate_sparse_data();
+    if (spherical) {
+        normalize_rows(data);
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    // Initialize centroids with the first K points, same as the dense versions (a duplicated column just gets added twice)
+    double *centroids = calloc((size_t)K * DIM, sizeof(double));
+    for (i = 0; i < K; i++) {
+        for (long p = data->row_ptr[i]; p < data->row_ptr[i + 1]; p++) {
+            centroids[(size_t)i * DIM + data->col_idx[p]] += data->values[p];
+        }
+    }
+    double centroid_norms_sq[K];
+    double *centroids_t = malloc((size_t)DIM * K * sizeof(double));
+
+    int num_threads = omp_get_max_threads();
+    double *thread_sums = malloc((size_t)num_threads * K * DIM * sizeof(double));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop, same structure as K_means_para.c.
+
+    double start_time = omp_get_wtime();
+
+    int changed = 1;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+
+        // ||c||^2 for every centroid and the transposed copy for sparse_dot_all, once per iteration instead of once per point
+        for (i = 0; i < K; i++) {
+            double norm_sq = 0.0;
+            for (j = 0; j < DIM; j++) {
+                double x = centroids[(size_t)i * DIM + j];
+                norm_sq += x * x;
+                centroids_t[(size_t)j * K + i] = x;
+            }
+            centroid_norms_sq[i] = norm_sq;
+        }
+
+        // Assignment Step: only the non zeros of each point get read.
+        // Euclidean: minimize ||c||^2 - 2 x.c      Spherical: maximize x.c (both sides have length 1), which is the same as minimizing -x.c
+        #pragma omp parallel for reduction(|:changed) schedule(dynamic, 1000)
+        for (i = 0; i < NUM_POINTS; i++) {
+            double dots[K];
+            sparse_dot_all(data, i, centroids_t, dots);
+            int best_cluster = 0;
+            double best_score = 0.0;
+            for (int c = 0; c < K; c++) {
+                double score = spherical ? -dots[c] : centroid_norms_sq[c] - 2.0 * dots[c];
+                if (c == 0 || score < best_score) {
+                    best_score = score;
+                    best_cluster = c;
+                }
+            }
+            if (labels[i] != best_cluster) {
+                labels[i] = (label_t)best_cluster;
+                changed |= 1;
+            }
+        }
+
+        // Update Step: same partial sum technique as K_means_para.c, but the thread local sums are K x DIM doubles now so they live on the heap and the merge is
+        // parallel over the features instead of going through a critical section
+        int counts[K] = {0};
+        memset(thread_sums, 0, (size_t)num_threads * K * DIM * sizeof(double));
+
+        #pragma omp parallel
+        {
+            double *local_sums = thread_sums + (size_t)omp_get_thread_num() * K * DIM;
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int cluster = labels[i];
+                local_counts[cluster]++;
+                for (long p = data->row_ptr[i]; p < data->row_ptr[i + 1]; p++) {
+                    local_sums[(size_t)cluster * DIM + data->col_idx[p]] += data->values[p];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                }
+            }
+            #pragma omp barrier
+
+            #pragma omp for
+            for (long f = 0; f < (long)K * DIM; f++) {
+                double sum = 0.0;
+                for (int t = 0; t < num_threads; t++) {
+                    sum += thread_sums[(size_t)t * K * DIM + f];
+                }
+                int c = f / DIM;
+                if (counts[c] > 0) {
+                    centroids[f] = sum / counts[c];
+                }
+            }
+        }
+
+        // spherical K-Means: the new centroid is the mean pushed back onto the unit sphere
+        if (spherical) {
+            for (i = 0; i < K; i++) {
+                double norm_sq = 0.0;
+                for (j = 0; j < DIM; j++) {
+                    norm_sq += centroids[(size_t)i * DIM + j] * centroids[(size_t)i * DIM + j];
+                }
+                if (norm_sq > 0.0) {
+                    double inv = 1.0 / sqrt(norm_sq);
+                    for (j = 0; j < DIM; j++) {
+                        centroids[(size_t)i * DIM + j] *= inv;
+                    }
+                }
+            }
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results. the centroids have DIM entries each so we only print the cluster sizes and the strongest feature of each centroid.
+    int sizes[K] = {0};
+    for (i = 0; i < NUM_POINTS; i++) {
+        sizes[labels[i]]++;
+    }
+    printf("K-Means (%s) converged in %d iterations.\n", spherical ? "spherical" : "euclidean", iter);
+    printf("Elapsed time (sparse): %f seconds (%ld non zeros)\n", elapsed, data->nnz);
+    printf("Final clusters:\n");
+    for (i = 0; i < K; i++) {
+        int top = 0;
+        for (j = 1; j < DIM; j++) {
+            if (centroids[(size_t)i * DIM + j] > centroids[(size_t)i * DIM + top]) top = j;
+        }
+        printf("Cluster %d: %d points, strongest feature %d (%f)\n", i, sizes[i], top, centroids[(size_t)i * DIM + top]);
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    free(thread_sums);
+    free(centroids_t);
+    free(centroids);
+    free(data->row_ptr);
+    free(data->col_idx);
+    free(data->values);
+    free(data);
+    free(labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,375 @@
+// Streaming K-Means: instead of one batch run over data that is already in memory, points keep arriving (on stdin or a local UNIX socket) and the centroids are
+// updated online, one batch at a time. Memory stays bounded no matter how many points come in: we only ever hold one batch plus the centroids.
+// Two ways to forget old data so the centroids can follow a stream that changes over time:
+//      decay  (default) -> after every batch the old weight of each centroid is multiplied by DECAY, so old batches fade out slowly (DECAY 1.0 = never forget)
+//      window           -> the centroids are the mean of the last WINDOW batches only
+// The points come in as raw binary doubles (DIM per point), same layout as the out of core data file.
+// Send SIGUSR1 to the process to get the current centroids printed to stderr while it is running.
+// usage: ./K_means_stream [decay | window] [socket_path]         read points from stdin, or accept connections on socket_path
+//        ./K_means_stream gen <num_points> [socket_path]        load generator: write random points to stdout (or to the socket) as fast as possible
+// example: ./K_means_stream gen 50000000 | ./K_means_stream
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define BATCH_SIZE 100000   // points per batch
+#define DECAY 0.99          // how much of its old weight a centroid keeps after each batch (decay mode)
+#define WINDOW 50           // number of batches the centroids are computed over (window mode)
+#define RESYNC WINDOW       // window mode: every RESYNC batches the running totals are summed again from the ring, so the rounding of all the
+                            // += / -= pairs can't pile up over an endless stream
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Input helpers.
+
+static volatile sig_atomic_t publish_requested = 0;
+static volatile sig_atomic_t stop_requested = 0;   // SIGINT / SIGTERM, the only way to end the socket mode
+
+static void on_sigusr1(int sig) {
+    (void)sig;
+    publish_requested = 1;
+}
+
+static void on_stop(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// reads until buf is full or the input ends, returns the number of bytes read. *ended is set when the input is over (end of file or an error).
+// a signal that wants something from the main loop (stop or publish) also makes it return early, with *ended still 0, so the caller can
+// deal with it and call again for the rest of the batch
+static size_t read_full(int fd, void *buf, size_t len, int *ended) {
+    char *p = buf;
+    size_t got = 0;
+    *ended = 0;
+    while (got < len) {
+        ssize_t r = read(fd, p + got, len - got);
+        if (r == 0) {
+            *ended = 1;
+            break;
+        }
+        if (r < 0) {
+            if (errno == EINTR) {
+                if (stop_requested || publish_requested) break;
+                continue;
+            }
+            perror("stream: read");
+            *ended = 1;
+            break;
+        }
+        got += r;
+    }
+    return got;
+}
+
+static int open_socket(const char *path, int listening) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("stream: socket");
+        exit(1);
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    if (listening) {
+        unlink(path);
+        if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+            perror("stream: bind");
+            exit(1);
+        }
+    } else if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("stream: connect");
+        exit(1);
+    }
+    return fd;
+}
+
+static void print_centroids(FILE *out, double centroids[K][DIM], int initialized) {
+    if (!initialized) {
+        fprintf(out, "no data\n");     // the first K points haven't arrived yet
+        return;
+    }
+    for (int i = 0; i < K; i++) {
+        fprintf(out, "Cluster %d: ", i);
+        for (int j = 0; j < DIM; j++) {
+            fprintf(out, "%f ", centroids[i][j]);
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The load generator: the same rand() points as every other file, written out in batches.
+
+static int generate(long num_points, const char *socket_path) {
+    int fd = socket_path ? open_socket(socket_path, 0) : STDOUT_FILENO;
+    double *buf = malloc((size_t)BATCH_SIZE * DIM * sizeof(double));
+    for (long first = 0; first < num_points; first += BATCH_SIZE) {
+        long count = num_points - first < BATCH_SIZE ? num_points - first : BATCH_SIZE;
+        for (long i = 0; i < count * DIM; i++) {
+            buf[i] = (double)rand() / RAND_MAX;
+        }
+        const char *p = (const char *)buf;
+        size_t left = count * DIM * sizeof(double);
+        while (left > 0) {
+            ssize_t w = write(fd, p, left);
+            if (w <= 0) {
+                perror("stream: write");
+                free(buf);
+                return 1;
+            }
+            p += w;
+            left -= w;
+        }
+    }
+    free(buf);
+    if (socket_path) close(fd);
+    return 0;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+
+    // the load generator and the consumer are the same program so they always agree on DIM and the format
+    if (argc > 2 && strcmp(argv[1], "gen") == 0) {
+        return generate(atol(argv[2]), argc > 3 ? argv[3] : NULL);
+    }
+    int window_mode = argc > 1 && strcmp(argv[1], "window") == 0;
+    const char *socket_path = argc > 2 ? argv[2] : NULL;
+
+    signal(SIGPIPE, SIG_IGN);
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    // no SA_RESTART, so a blocking accept returns and we can publish the centroids / print the results even while no producer is connected
+    sa.sa_handler = on_sigusr1;
+    sigaction(SIGUSR1, &sa, NULL);
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+// ===================================================================================================================================
+// State. All of it is fixed size: one batch, the centroids and their weights, and the per batch sums for the window mode.
+// there are no labels, a point is only needed until its batch has been folded into the centroids.
+// the batch has room for K - 1 extra points in front: if the stream starts with fewer than K points (a producer that sends a few points and
+// disconnects), they wait there until the starting centroids are complete instead of ending the program
+
+    double *batch = malloc((size_t)(BATCH_SIZE + K) * DIM * sizeof(double));
+    double centroids[K][DIM] = {{0}};
+    double weights[K] = {0};                    // decay mode: how many (decayed) points are behind each centroid
+    double (*window_sums)[K][DIM] = calloc(WINDOW, sizeof(*window_sums));   // window mode: the sums and counts of the last WINDOW batches
+    double (*window_counts)[K] = calloc(WINDOW, sizeof(*window_counts));
+    double total_sums[K][DIM] = {{0}};          // window mode: running total over the window
+    double total_counts[K] = {0};
+    int initialized = 0;
+
+    int listen_fd = socket_path ? open_socket(socket_path, 1) : -1;
+    int fd = socket_path ? -1 : STDIN_FILENO;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The loop: read a batch, assign it in parallel (same partial sums as K_means_para.c), fold the batch into the centroids.
+
+    double start_time = omp_get_wtime();
+    long total_points = 0;
+    long num_batches = 0;
+    int pending = 0;            // points waiting at the front of batch for the starting centroids
+    size_t filled = 0;          // bytes of the current batch read so far (a batch can take several read_full calls when signals come in)
+    const size_t batch_bytes = (size_t)BATCH_SIZE * DIM * sizeof(double);
+
+    for (;;) {
+        if (publish_requested) {
+            publish_requested = 0;
+            fprintf(stderr, "after %ld points:\n", total_points);
+            print_centroids(stderr, centroids, initialized);
+        }
+        if (fd < 0) {
+            fd = accept(listen_fd, NULL, NULL);     // socket mode: serve one producer at a time until we get stopped
+            if (fd < 0) {
+                if (errno == EINTR && !stop_requested) continue;
+                if (errno != EINTR) perror("stream: accept");
+                break;
+            }
+        }
+        int ended;
+        filled += read_full(fd, (char *)&batch[(size_t)pending * DIM] + filled, batch_bytes - filled, &ended);
+        if (!ended && filled < batch_bytes && !stop_requested) {
+            continue;   // interrupted for a publish, go serve it and then read the rest of the batch
+        }
+        int n = pending + (int)(filled / (DIM * sizeof(double)));  // a half point at the very end of the input is dropped
+        int input_over = ended;
+        filled = 0;
+        if (ended && socket_path) {
+            // the producer is done
+            close(fd);
+            fd = -1;
+        }
+
+        if (!initialized && n < K) {
+            pending = n;    // not enough points for the starting centroids yet, keep them and wait for more
+            n = 0;
+        }
+
+        if (n > 0) {
+            // the first K points of the stream are the starting centroids, same as the batch versions
+            pending = 0;
+            if (!initialized) {
+                for (i = 0; i < K; i++) {
+                    for (j = 0; j < DIM; j++) {
+                        centroids[i][j] = batch[i * DIM + j];
+                    }
+                }
+                initialized = 1;
+            }
+
+            double batch_sums[K][DIM] = {{0}};
+            double batch_counts[K] = {0};
+
+            #pragma omp parallel
+            {
+                double local_sums[K][DIM] = {{0}};
+                double local_counts[K] = {0};
+
+                #pragma omp for nowait
+                for (int p = 0; p < n; p++) {
+                    double *point = &batch[(size_t)p * DIM];
+                    int best_cluster = 0;
+                    double best_dist = distance_sq(point, centroids[0]);
+                    for (int c = 1; c < K; c++) {
+                        double d = distance_sq(point, centroids[c]);
+                        if (d < best_dist) {
+                            best_dist = d;
+                            best_cluster = c;
+                        }
+                    }
+                    local_counts[best_cluster] += 1.0;
+                    for (int d = 0; d < DIM; d++) {
+                        local_sums[best_cluster][d] += point[d];
+                    }
+                }
+
+                #pragma omp critical
+                {
+                    for (int c = 0; c < K; c++) {
+                        batch_counts[c] += local_counts[c];
+                        for (int d = 0; d < DIM; d++) {
+                            batch_sums[c][d] += local_sums[c][d];
+                        }
+                    }
+                }
+            }
+
+            if (window_mode) {
+                // swap the oldest batch out of the running total and this one in
+                int slot = num_batches % WINDOW;
+                int resync = (num_batches + 1) % RESYNC == 0;
+                for (int c = 0; c < K; c++) {
+                    total_counts[c] += batch_counts[c] - window_counts[slot][c];
+                    window_counts[slot][c] = batch_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        total_sums[c][d] += batch_sums[c][d] - window_sums[slot][c][d];
+                        window_sums[slot][c][d] = batch_sums[c][d];
+                    }
+                    if (resync) {
+                        // the exact sum of what is in the ring right now (K * DIM * WINDOW additions, nothing next to a batch)
+                        total_counts[c] = 0.0;
+                        for (int d = 0; d < DIM; d++) {
+                            total_sums[c][d] = 0.0;
+                        }
+                        for (int w = 0; w < WINDOW; w++) {
+                            total_counts[c] += window_counts[w][c];
+                            for (int d = 0; d < DIM; d++) {
+                                total_sums[c][d] += window_sums[w][c][d];
+                            }
+                        }
+                    }
+                    if (total_counts[c] > 0.5) {    // counts are whole numbers stored as doubles
+                        for (int d = 0; d < DIM; d++) {
+                            centroids[c][d] = total_sums[c][d] / total_counts[c];
+                        }
+                    }
+                }
+            } else {
+                // decayed running mean: the old centroid counts as weights[c] * DECAY points, the batch adds its own points
+                for (int c = 0; c < K; c++) {
+                    double old_weight = weights[c] * DECAY;
+                    weights[c] = old_weight + batch_counts[c];
+                    if (weights[c] > 0.0) {
+                        for (int d = 0; d < DIM; d++) {
+                            centroids[c][d] = (old_weight * centroids[c][d] + batch_sums[c][d]) / weights[c];
+                        }
+                    }
+                }
+            }
+            total_points += n;
+            num_batches++;
+        }
+
+        if (stop_requested || (input_over && !socket_path)) break;     // stopped, or in stdin mode: the input has ended
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("Processed %ld points in %ld batches (%s mode)\n", total_points, num_batches, window_mode ? "window" : "decay");
+    printf("Elapsed time (stream): %f seconds, %.0f points/sec\n", elapsed, elapsed > 0.0 ? total_points / elapsed : 0.0);
+    printf("Final centroids:\n");
+    print_centroids(stdout, centroids, initialized);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    if (listen_fd >= 0) {
+        close(listen_fd);
+        unlink(socket_path);
+    }
+    free(batch);
+    free(window_sums);
+    free(window_counts);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,307 @@
+// K-selection sweep: instead of rerunning the program once for every K ("try different values of k" like Understanding_KMeans.c says), one run clusters the data
+// for every K in [K_MIN, K_MAX] and prints a table of scores to pick K from:
+//      inertia     -> the total squared distance of the points to their centroid (look for the "elbow" where adding clusters stops helping much)
+//      silhouette  -> computed on a sample of SAMPLE_SIZE points since the exact one is O(NUM_POINTS^2). closer to 1 is better
+// usage: ./K_means_sweep [concurrent | warm | cold]
+//      concurrent (default) -> every K is an independent run starting from the first K points, the runs are spread over the threads (one K per thread)
+//      warm                 -> K + 1 starts from the converged centroids of K plus one new centroid that splits the cluster with the largest error.
+//                              the idea is that most of the clusters are already in place, but on the uniform data it takes about as many
+//                              iterations in total as cold, so it isn't the default
+//      cold                 -> every K is an independent run one after the other, each with the parallel loops of K_means_para.c (the baseline to compare against)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K_MIN 2             // smallest number of clusters we try
+#define K_MAX 10            // largest number of clusters we try
+#define MAX_ITER 100        // Maximum iterations
+#define SAMPLE_SIZE 2000    // points used for the silhouette
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K_MAX <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K_MAX <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop of K_means_para.c, but with k as a parameter (at most K_MAX) instead of a #define. The centroids passed in are the starting point.
+// parallel = 0 runs it on the calling thread only, that is what the concurrent mode uses since there the parallelism is across the runs.
+// returns the number of iterations, and the inertia of the final assignment in *inertia
+
+int kmeans(double **data, int k, double centroids[K_MAX][DIM], label_t *labels, int parallel, double *inertia) {
+    int iter;
+    int changed = 1;
+    double total = 0.0;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        total = 0.0;
+        double new_centroids[K_MAX][DIM] = {{0}};
+        int counts[K_MAX] = {0};
+
+        #pragma omp parallel if(parallel) reduction(|:changed) reduction(+:total)
+        {
+            double local_new_centroids[K_MAX][DIM] = {{0}};
+            int local_counts[K_MAX] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int best_cluster = 0;
+                double best_dist = distance_sq(data[i], centroids[0]);
+                for (int j = 1; j < k; j++) {
+                    double d = distance_sq(data[i], centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed |= 1;
+                }
+                total += best_dist;
+                local_counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[best_cluster][d] += data[i][d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < k; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (int c = 0; c < k; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    // total was measured against the centroids of the last assignment. once converged those are the final centroids, so this is the inertia of the result
+    *inertia = total;
+    return iter;
+}
+
+// approximate silhouette: the usual formula, but only over the sample points (and only against other sample points)
+double sampled_silhouette(double **data, const int *sample, const label_t *labels, int k) {
+    double total = 0.0;
+    #pragma omp parallel for reduction(+:total) schedule(dynamic, 16)
+    for (int a = 0; a < SAMPLE_SIZE; a++) {
+        double dist_sum[K_MAX] = {0};
+        int count[K_MAX] = {0};
+        int own = labels[sample[a]];
+        for (int b = 0; b < SAMPLE_SIZE; b++) {
+            if (b == a) continue;
+            int c = labels[sample[b]];
+            dist_sum[c] += sqrt(distance_sq(data[sample[a]], data[sample[b]]));
+            count[c]++;
+        }
+        if (count[own] == 0) continue;  // alone in its cluster (within the sample): silhouette 0 by definition
+        double mean_own = dist_sum[own] / count[own];
+        double mean_other = -1.0;
+        for (int c = 0; c < k; c++) {
+            if (c == own || count[c] == 0) continue;
+            double m = dist_sum[c] / count[c];
+            if (mean_other < 0.0 || m < mean_other) mean_other = m;
+        }
+        if (mean_other < 0.0) continue;
+        double larger = mean_own > mean_other ? mean_own : mean_other;
+        if (larger > 0.0) total += (mean_other - mean_own) / larger;
+    }
+    return total / SAMPLE_SIZE;
+}
+
+// for the warm start: the new centroid goes into the cluster with the largest squared error, halfway between its centroid and its furthest point,
+// so that cluster gets split in two and all the others stay where they are
+static void split_worst_cluster(double **data, int k, double centroids[K_MAX][DIM], const label_t *labels, double new_centroid[DIM]) {
+    double sse[K_MAX] = {0};
+    double far_dist[K_MAX];
+    int far_point[K_MAX];
+    for (int c = 0; c < k; c++) {
+        far_dist[c] = -1.0;
+        far_point[c] = 0;
+    }
+    #pragma omp parallel
+    {
+        double my_sse[K_MAX] = {0};
+        double my_far_dist[K_MAX];
+        int my_far_point[K_MAX];
+        for (int c = 0; c < k; c++) {
+            my_far_dist[c] = -1.0;
+            my_far_point[c] = 0;
+        }
+        #pragma omp for nowait
+        for (int i = 0; i < NUM_POINTS; i++) {
+            int c = labels[i];
+            double d = distance_sq(data[i], centroids[c]);
+            my_sse[c] += d;
+            if (d > my_far_dist[c]) {
+                my_far_dist[c] = d;
+                my_far_point[c] = i;
+            }
+        }
+        #pragma omp critical
+        {
+            for (int c = 0; c < k; c++) {
+                sse[c] += my_sse[c];
+                // lowest index on ties so the result doesn't depend on the threads
+                if (my_far_dist[c] > far_dist[c] || (my_far_dist[c] == far_dist[c] && my_far_point[c] < far_point[c])) {
+                    far_dist[c] = my_far_dist[c];
+                    far_point[c] = my_far_point[c];
+                }
+            }
+        }
+    }
+    int worst = 0;
+    for (int c = 1; c < k; c++) {
+        if (sse[c] > sse[worst]) worst = c;
+    }
+    for (int d = 0; d < DIM; d++) {
+        new_centroid[d] = 0.5 * (centroids[worst][d] + data[far_point[worst]][d]);
+    }
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+    const char *mode = argc > 1 ? argv[1] : "concurrent";
+    if (strcmp(mode, "warm") != 0 && strcmp(mode, "concurrent") != 0 && strcmp(mode, "cold") != 0) {
+        fprintf(stderr, "usage: %s [concurrent | warm | cold]\n", argv[0]);
+        return 1;
+    }
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c. The silhouette sample is every (NUM_POINTS / SAMPLE_SIZE)-th point, so it is the same on every run.
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    int sample[SAMPLE_SIZE];
+    for (i = 0; i < SAMPLE_SIZE; i++) {
+        sample[i] = (int)((long)i * NUM_POINTS / SAMPLE_SIZE);
+    }
+
+    const int num_k = K_MAX - K_MIN + 1;
+    int iterations[K_MAX - K_MIN + 1];
+    double inertia[K_MAX - K_MIN + 1], silhouette[K_MAX - K_MIN + 1], run_time[K_MAX - K_MIN + 1];
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The sweep.
+
+    double start_time = omp_get_wtime();
+
+    if (strcmp(mode, "warm") == 0) {
+        label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+        double centroids[K_MAX][DIM];
+        for (i = 0; i < K_MIN; i++) {
+            for (j = 0; j < DIM; j++) {
+                centroids[i][j] = data[i][j];
+            }
+        }
+        for (int k = K_MIN; k <= K_MAX; k++) {
+            double t = omp_get_wtime();
+            if (k > K_MIN) {
+                split_worst_cluster(data, k - 1, centroids, labels, centroids[k - 1]);
+            }
+            iterations[k - K_MIN] = kmeans(data, k, centroids, labels, 1, &inertia[k - K_MIN]);
+            silhouette[k - K_MIN] = sampled_silhouette(data, sample, labels, k);
+            run_time[k - K_MIN] = omp_get_wtime() - t;
+        }
+        free(labels);
+    } else {
+        int concurrent = strcmp(mode, "concurrent") == 0;
+        // concurrent: one K per thread, dynamic since bigger K takes longer. every run has its own labels, so this needs num_k label arrays at once
+        #pragma omp parallel for schedule(dynamic, 1) if(concurrent)
+        for (int r = 0; r < num_k; r++) {
+            int k = K_MIN + r;
+            double t = omp_get_wtime();
+            label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+            double centroids[K_MAX][DIM];
+            for (int c = 0; c < k; c++) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = data[c][d];
+                }
+            }
+            iterations[r] = kmeans(data, k, centroids, labels, !concurrent, &inertia[r]);
+            silhouette[r] = sampled_silhouette(data, sample, labels, k);
+            run_time[r] = omp_get_wtime() - t;
+            free(labels);
+        }
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    int total_iterations = 0;
+    printf("  K  iterations      inertia   silhouette    time (s)\n");
+    for (int r = 0; r < num_k; r++) {
+        printf("%3d  %10d  %11.4f  %11.4f  %10.4f\n", K_MIN + r, iterations[r], inertia[r], silhouette[r], run_time[r]);
+        total_iterations += iterations[r];
+    }
+    printf("Sweep (%s): %d iterations in total, elapsed time %f seconds\n", mode, total_iterations, elapsed);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,325 @@
+// Cache blocked (tiled) assignment for big models. With K = 3 and DIM = 2 the centroids are 48 bytes and never leave L1, but with K = 8192 and DIM = 64
+// they are 4MB, and the usual loop (one point against ALL the centroids, then the next point) streams the whole centroid table through the cache for
+// every single point. Here the assignment works on a tile of points against a tile of centroids at a time: the point tile stays in L1, the centroid
+// tile stays in L2, and every centroid loaded is used by the whole point tile before it gets evicted. The best distance / label found so far for each
+// point is kept in a small array and updated tile by tile. Inside a tile the points go 4 at a time against each centroid, so a centroid is loaded
+// once for 4 points and the 4 sums run side by side.
+// The tile sizes are picked from the cache sizes reported by sysconf (with defaults for when it doesn't know).
+// The program runs the same iterations with the normal loop and with the tiled one and checks that they agree.
+// usage: ./K_means_tiled [point_tile centroid_tile]       to override the detected tile sizes
+
+#define _GNU_SOURCE     // for _SC_LEVEL1_DCACHE_SIZE / _SC_LEVEL2_CACHE_SIZE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <unistd.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// a "large model" instead of the usual 2D / K = 3 setup, otherwise there is nothing to block
+
+#define NUM_POINTS 20000    // points
+#define DIM 64              // dimensions per point
+#define K 8192              // Number of clusters (8192 * 64 doubles = 4MB of centroids)
+#define MAX_ITER 3          // Maximum iterations (one iteration here is a lot more work than a whole normal run, 3 is enough to compare)
+
+#define DEFAULT_L1 (32 * 1024)      // used when sysconf can't tell us
+#define DEFAULT_L2 (1024 * 1024)
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Tile sizes. Half of L1 for the point tile (the rest is for the best distance array, the labels and whatever else is around), half of L2 for
+// the centroid tile. both are rounded down to a multiple of 8 and never go below 8.
+
+static long cache_size(int name, long fallback) {
+    long size = sysconf(name);
+    return size > 0 ? size : fallback;
+}
+
+static int tile_from_bytes(long bytes, int max) {
+    int t = (int)(bytes / (DIM * sizeof(double)));
+    t &= ~7;
+    if (t < 8) t = 8;
+    if (t > max) t = max;
+    return t;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The two assignment kernels. Both fill labels (returning how many points changed cluster) and leave the sums / counts for the update step.
+// the comparisons are the same in both (distance_sq, strictly smaller wins, centroids in increasing order), so the labels come out identical.
+
+// the usual loop from K_means_para.c
+static long assign_plain(double *points, double *centroids, label_t *labels, double sums[K][DIM], long counts[K]) {
+    long changed = 0;
+    #pragma omp parallel reduction(+:changed)
+    {
+        double (*local_sums)[DIM] = calloc(K, sizeof(*local_sums));
+        long *local_counts = calloc(K, sizeof(long));
+
+        #pragma omp for nowait
+        for (int i = 0; i < NUM_POINTS; i++) {
+            double *point = &points[(size_t)i * DIM];
+            int best_cluster = 0;
+            double best_dist = distance_sq(point, &centroids[0]);
+            for (int j = 1; j < K; j++) {
+                double d = distance_sq(point, &centroids[(size_t)j * DIM]);
+                if (d < best_dist) {
+                    best_dist = d;
+                    best_cluster = j;
+                }
+            }
+            if (labels[i] != best_cluster) {
+                labels[i] = (label_t)best_cluster;
+                changed++;
+            }
+            local_counts[best_cluster]++;
+            for (int d = 0; d < DIM; d++) {
+                local_sums[best_cluster][d] += point[d];
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int c = 0; c < K; c++) {
+                counts[c] += local_counts[c];
+                for (int d = 0; d < DIM; d++) {
+                    sums[c][d] += local_sums[c][d];
+                }
+            }
+        }
+        free(local_sums);
+        free(local_counts);
+    }
+    return changed;
+}
+
+// the tiled loop. every thread takes whole point tiles, and walks the centroid tiles in the same order for each of them.
+static long assign_tiled(double *points, double *centroids, label_t *labels, double sums[K][DIM], long counts[K], int point_tile, int centroid_tile) {
+    long changed = 0;
+    const int num_point_tiles = (NUM_POINTS + point_tile - 1) / point_tile;
+
+    #pragma omp parallel reduction(+:changed)
+    {
+        double (*local_sums)[DIM] = calloc(K, sizeof(*local_sums));
+        long *local_counts = calloc(K, sizeof(long));
+        double *best_dist = malloc(point_tile * sizeof(double));
+        int *best_cluster = malloc(point_tile * sizeof(int));
+
+        #pragma omp for schedule(static) nowait
+        for (int pt = 0; pt < num_point_tiles; pt++) {
+            int first = pt * point_tile;
+            int n = NUM_POINTS - first < point_tile ? NUM_POINTS - first : point_tile;
+            for (int p = 0; p < n; p++) {
+                best_dist[p] = DBL_MAX;
+                best_cluster[p] = 0;
+            }
+
+            for (int c0 = 0; c0 < K; c0 += centroid_tile) {
+                int c1 = c0 + centroid_tile < K ? c0 + centroid_tile : K;
+                int p = 0;
+                // 4 points at a time against each centroid: every centroid value loaded is used 4 times, and the 4 sums are independent so
+                // the CPU can work on them at the same time instead of waiting for one long chain of additions.
+                // each sum still goes over d in the same order as distance_sq, so the distances are bit for bit the same.
+                for (; p + 4 <= n; p += 4) {
+                    double *x0 = &points[(size_t)(first + p) * DIM];
+                    double *x1 = x0 + DIM, *x2 = x1 + DIM, *x3 = x2 + DIM;
+                    for (int c = c0; c < c1; c++) {
+                        double *centroid = &centroids[(size_t)c * DIM];
+                        double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+                        for (int d = 0; d < DIM; d++) {
+                            double diff0 = x0[d] - centroid[d];
+                            double diff1 = x1[d] - centroid[d];
+                            double diff2 = x2[d] - centroid[d];
+                            double diff3 = x3[d] - centroid[d];
+                            s0 += diff0 * diff0;
+                            s1 += diff1 * diff1;
+                            s2 += diff2 * diff2;
+                            s3 += diff3 * diff3;
+                        }
+                        if (s0 < best_dist[p])     { best_dist[p] = s0;     best_cluster[p] = c; }
+                        if (s1 < best_dist[p + 1]) { best_dist[p + 1] = s1; best_cluster[p + 1] = c; }
+                        if (s2 < best_dist[p + 2]) { best_dist[p + 2] = s2; best_cluster[p + 2] = c; }
+                        if (s3 < best_dist[p + 3]) { best_dist[p + 3] = s3; best_cluster[p + 3] = c; }
+                    }
+                }
+                // the leftover points of the tile one at a time
+                for (; p < n; p++) {
+                    double *point = &points[(size_t)(first + p) * DIM];
+                    for (int c = c0; c < c1; c++) {
+                        double d = distance_sq(point, &centroids[(size_t)c * DIM]);
+                        if (d < best_dist[p]) {
+                            best_dist[p] = d;
+                            best_cluster[p] = c;
+                        }
+                    }
+                }
+            }
+
+            for (int p = 0; p < n; p++) {
+                int i = first + p;
+                if (labels[i] != best_cluster[p]) {
+                    labels[i] = (label_t)best_cluster[p];
+                    changed++;
+                }
+                local_counts[best_cluster[p]]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_sums[best_cluster[p]][d] += points[(size_t)i * DIM + d];
+                }
+            }
+        }
+
+        #pragma omp critical
+        {
+            for (int c = 0; c < K; c++) {
+                counts[c] += local_counts[c];
+                for (int d = 0; d < DIM; d++) {
+                    sums[c][d] += local_sums[c][d];
+                }
+            }
+        }
+        free(local_sums);
+        free(local_counts);
+        free(best_dist);
+        free(best_cluster);
+    }
+    return changed;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop with either kernel, returns the number of iterations
+
+static int kmeans(double *points, double *centroids, label_t *labels, int tiled, int point_tile, int centroid_tile) {
+    int iter;
+    long changed = 1;
+    double (*sums)[DIM] = malloc(K * sizeof(*sums));
+    long *counts = malloc(K * sizeof(long));
+
+    memset(labels, 0, NUM_POINTS * sizeof(label_t));
+    memcpy(centroids, points, (size_t)K * DIM * sizeof(double));   // the first K points, like always
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        memset(sums, 0, K * sizeof(*sums));
+        memset(counts, 0, K * sizeof(long));
+        if (tiled) {
+            changed = assign_tiled(points, centroids, labels, sums, counts, point_tile, centroid_tile);
+        } else {
+            changed = assign_plain(points, centroids, labels, sums, counts);
+        }
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[(size_t)c * DIM + d] = sums[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    free(sums);
+    free(counts);
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    long i;
+
+    long l1 = cache_size(_SC_LEVEL1_DCACHE_SIZE, DEFAULT_L1);
+    long l2 = cache_size(_SC_LEVEL2_CACHE_SIZE, DEFAULT_L2);
+    int point_tile = tile_from_bytes(l1 / 2, NUM_POINTS);
+    int centroid_tile = tile_from_bytes(l2 / 2, K);
+    if (argc > 2) {
+        point_tile = atoi(argv[1]) > 0 ? atoi(argv[1]) : point_tile;
+        centroid_tile = atoi(argv[2]) > 0 ? atoi(argv[2]) : centroid_tile;
+    }
+
+// ===================================================================================================================================
+// Creating the data. one flat block of points this time, and the centroids are a flat K * DIM array since they no longer fit on the stack comfortably
+
+    double *points = malloc((size_t)NUM_POINTS * DIM * sizeof(double));
+    for (i = 0; i < (long)NUM_POINTS * DIM; i++) {
+        points[i] = (double)rand() / RAND_MAX;
+    }
+
+    label_t *labels = malloc(NUM_POINTS * sizeof(label_t));
+    label_t *tiled_labels = malloc(NUM_POINTS * sizeof(label_t));
+    double *centroids = malloc((size_t)K * DIM * sizeof(double));
+    double *tiled_centroids = malloc((size_t)K * DIM * sizeof(double));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    double start_time = omp_get_wtime();
+    int plain_iterations = kmeans(points, centroids, labels, 0, 0, 0);
+    double plain_time = omp_get_wtime() - start_time;
+
+    start_time = omp_get_wtime();
+    int tiled_iterations = kmeans(points, tiled_centroids, tiled_labels, 1, point_tile, centroid_tile);
+    double tiled_time = omp_get_wtime() - start_time;
+
+    long mismatches = 0;
+    for (i = 0; i < NUM_POINTS; i++) {
+        mismatches += labels[i] != tiled_labels[i];
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("L1d %ld bytes, L2 %ld bytes -> point tile %d, centroid tile %d (centroid table %zu KB)\n",
+           l1, l2, point_tile, centroid_tile, (size_t)K * DIM * sizeof(double) / 1024);
+    printf("Elapsed time (point by point): %f seconds, %d iterations\n", plain_time, plain_iterations);
+    printf("Elapsed time (tiled):          %f seconds, %d iterations\n", tiled_time, tiled_iterations);
+    printf("Labels that differ: %ld, first centroid: %f %f\n", mismatches, centroids[0], tiled_centroids[0]);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    free(points);
+    free(labels);
+    free(tiled_labels);
+    free(centroids);
+    free(tiled_centroids);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
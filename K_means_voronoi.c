@@ -0,0 +1,308 @@
+// Same K-Means as K_means_para.c but the assignment is a table lookup. In 2D with a handful of centroids, "which centroid is nearest" only depends on
+// which Voronoi cell of the centroids the point lies in, so at the start of every iteration we rasterize the Voronoi diagram onto a GRID_RES x GRID_RES
+// grid over the data's bounding box. A grid cell that lies completely inside one Voronoi cell stores that centroid, and every point in it gets its label
+// with one lookup instead of K distance computations. Only the grid cells a Voronoi edge runs through are marked MIXED, and their points fall back to
+// the exact distance_sq loop.
+// The labels are exactly the ones of the normal loop (the program runs both and compares).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define GRID_RES 256        // grid cells per side, 256 * 256 cells * 2 bytes = 128KB so the table stays in L2
+#define MARGIN_REL 1e-9     // see rasterize(), relative to the squared distances so it works for any scale of the data
+
+#if DIM != 2
+#error "the lookup table is a 2D grid, DIM has to be 2"
+#endif
+#if K > 32767
+#error "grid cells store the centroid as a short"
+#endif
+#define MIXED (-1)
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// the normal search over all centroids, also gives how much closer the winner is than the runner up, as a fraction of the two distances
+static int nearest(double *point, double centroids[K][DIM], double *margin) {
+    int best_cluster = 0;
+    double best_dist = distance_sq(point, centroids[0]);
+    double second_dist = 1e300;
+    for (int j = 1; j < K; j++) {
+        double d = distance_sq(point, centroids[j]);
+        if (d < best_dist) {
+            second_dist = best_dist;
+            best_dist = d;
+            best_cluster = j;
+        } else if (d < second_dist) {
+            second_dist = d;
+        }
+    }
+    *margin = (second_dist - best_dist) / (second_dist + best_dist);     // 0 / 0 = NaN for two centroids on top of each other, never > MARGIN_REL
+    return best_cluster;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The lookup table.
+// A grid cell is a rectangle, the Voronoi cells are convex, so if all 4 corners of a grid cell have the same nearest centroid, so does the whole
+// grid cell. To be safe against rounding we also want the winner to be ahead by more than MARGIN_REL * (best + second distance) at every corner.
+// The rounding error of a squared distance grows with the distance (and so with the scale of the data), a fixed margin would only fit data
+// around [0, 1]. The difference of two squared distances is linear in the point, so the lead inside the grid cell is at least the smallest lead
+// at its corners, and a grid cell is small enough that the distances don't change much across it: MARGIN_REL is millions of times the relative
+// rounding error of a double, so a point that is a rounding error outside its grid cell still can't flip.
+
+struct grid {
+    double lo[DIM];         // bounding box of the data
+    double cell_size[DIM];
+    double inv_cell_size[DIM];
+    short *cells;           // GRID_RES * GRID_RES, the centroid or MIXED
+    int *corner_label;      // (GRID_RES + 1)^2 scratch for the corners, -1 if the margin is too small
+};
+
+static void rasterize(struct grid *g, double centroids[K][DIM]) {
+    #pragma omp parallel
+    {
+        #pragma omp for
+        for (int cy = 0; cy <= GRID_RES; cy++) {
+            for (int cx = 0; cx <= GRID_RES; cx++) {
+                double corner[DIM] = {g->lo[0] + cx * g->cell_size[0], g->lo[1] + cy * g->cell_size[1]};
+                double margin;
+                int label = nearest(corner, centroids, &margin);
+                g->corner_label[cy * (GRID_RES + 1) + cx] = margin > MARGIN_REL ? label : -1;
+            }
+        }
+        // (the implicit barrier of the omp for above: all corners are done before any cell looks at them)
+        #pragma omp for
+        for (int cy = 0; cy < GRID_RES; cy++) {
+            const int *row = &g->corner_label[cy * (GRID_RES + 1)];
+            const int *next_row = row + (GRID_RES + 1);
+            for (int cx = 0; cx < GRID_RES; cx++) {
+                int label = row[cx];
+                int same = label >= 0 && row[cx + 1] == label && next_row[cx] == label && next_row[cx + 1] == label;
+                g->cells[cy * GRID_RES + cx] = same ? (short)label : MIXED;
+            }
+        }
+    }
+}
+
+static int grid_index(const struct grid *g, double *point) {
+    int cx = (int)((point[0] - g->lo[0]) * g->inv_cell_size[0]);
+    int cy = (int)((point[1] - g->lo[1]) * g->inv_cell_size[1]);
+    if (cx > GRID_RES - 1) cx = GRID_RES - 1;      // the points on the top / right edge of the bounding box
+    if (cy > GRID_RES - 1) cy = GRID_RES - 1;
+    return cy * GRID_RES + cx;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The K-Means loop, returns the number of iterations. lookup = 0 is K_means_para.c, lookup = 1 uses the grid.
+
+static long fallback_points;    // points that had to do the full search, over all iterations
+
+static int kmeans(double **data, double centroids[K][DIM], label_t *labels, struct grid *g, int lookup) {
+    int iter;
+    int changed = 1;
+    memset(labels, 0, NUM_POINTS * sizeof(label_t));
+    for (int c = 0; c < K; c++) {
+        for (int d = 0; d < DIM; d++) {
+            centroids[c][d] = data[c][d];
+        }
+    }
+    fallback_points = 0;
+
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {{0}};
+        int counts[K] = {0};
+        long fallbacks = 0;
+        if (lookup) {
+            rasterize(g, centroids);
+        }
+
+        #pragma omp parallel reduction(|:changed) reduction(+:fallbacks)
+        {
+            double local_new_centroids[K][DIM] = {{0}};
+            int local_counts[K] = {0};
+
+            #pragma omp for nowait
+            for (int i = 0; i < NUM_POINTS; i++) {
+                int best_cluster = lookup ? g->cells[grid_index(g, data[i])] : MIXED;
+                if (best_cluster == MIXED) {
+                    best_cluster = 0;
+                    double best_dist = distance_sq(data[i], centroids[0]);
+                    for (int j = 1; j < K; j++) {
+                        double d = distance_sq(data[i], centroids[j]);
+                        if (d < best_dist) {
+                            best_dist = d;
+                            best_cluster = j;
+                        }
+                    }
+                    fallbacks++;
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed |= 1;
+                }
+                local_counts[best_cluster]++;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[best_cluster][d] += data[i][d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+        fallback_points += fallbacks;
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main() {
+
+    int i, j;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+    label_t *lookup_labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    // the grid covers the bounding box of the data, which doesn't change between iterations
+    struct grid g;
+    double hi[DIM];
+    for (j = 0; j < DIM; j++) {
+        g.lo[j] = hi[j] = data[0][j];
+    }
+    for (i = 1; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            if (data[i][j] < g.lo[j]) g.lo[j] = data[i][j];
+            if (data[i][j] > hi[j]) hi[j] = data[i][j];
+        }
+    }
+    for (j = 0; j < DIM; j++) {
+        g.cell_size[j] = (hi[j] - g.lo[j]) / GRID_RES;
+        if (g.cell_size[j] <= 0.0) g.cell_size[j] = 1.0;   // all points on a line
+        g.inv_cell_size[j] = 1.0 / g.cell_size[j];
+    }
+    g.cells = malloc(GRID_RES * GRID_RES * sizeof(short));
+    g.corner_label = malloc((GRID_RES + 1) * (GRID_RES + 1) * sizeof(int));
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    double centroids[K][DIM], lookup_centroids[K][DIM];
+
+    double start_time = omp_get_wtime();
+    int exact_iterations = kmeans(data, centroids, labels, &g, 0);
+    double exact_time = omp_get_wtime() - start_time;
+
+    start_time = omp_get_wtime();
+    int lookup_iterations = kmeans(data, lookup_centroids, lookup_labels, &g, 1);
+    double lookup_time = omp_get_wtime() - start_time;
+
+    long mismatches = 0;
+    for (i = 0; i < NUM_POINTS; i++) {
+        mismatches += labels[i] != lookup_labels[i];
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("K-Means converged in %d iterations (exact) / %d iterations (lookup).\n", exact_iterations, lookup_iterations);
+    printf("Elapsed time (exact):  %f seconds\n", exact_time);
+    printf("Elapsed time (lookup): %f seconds, %.2f%% of the points needed the full search\n", lookup_time,
+           100.0 * fallback_points / ((double)NUM_POINTS * lookup_iterations));
+    printf("Labels that differ: %ld, centroids identical: %s\n", mismatches, memcmp(centroids, lookup_centroids, sizeof(centroids)) == 0 ? "yes" : "no");
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", lookup_centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+    free(lookup_labels);
+    free(g.cells);
+    free(g.corner_label);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -0,0 +1,338 @@
+// Same K-Means as K_means_para.c but with weighted points, plus a grid pre-aggregation step on top of it.
+// With DIM 2 and a million points, lots of points land really close to each other. So instead of clustering every single point, we cut the space into a fine grid,
+// replace all the points of a cell by one representative (the mean of those points) with a weight (how many points were in the cell) and run weighted K-Means on those.
+// the cost of an iteration then depends on the number of occupied cells and not on NUM_POINTS.
+// usage: ./K_means_weighted [refine]
+//      refine -> after the weighted run converges, do a few normal iterations over the raw points starting from those centroids
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define GRID_RES 256        // grid cells per dimension, so there are GRID_RES^DIM cells in total
+#define MAX_GRID_CELLS (1 << 22)    // every thread gets its own grid of (DIM doubles + an int) per cell, 4M cells would already be ~80MB per thread
+
+// GRID_RES^DIM written out, the preprocessor has no power operator. the grid only makes sense for low DIM anyway: the cell count grows
+// exponentially and soon there are more cells than points
+#if DIM == 1
+#define GRID_CELLS (GRID_RES)
+#elif DIM == 2
+#define GRID_CELLS (GRID_RES * GRID_RES)
+#elif DIM == 3
+#define GRID_CELLS (GRID_RES * GRID_RES * GRID_RES)
+#else
+#error "grid aggregation is only for DIM <= 3"
+#endif
+#if GRID_CELLS > MAX_GRID_CELLS
+#error "GRID_RES^DIM grid cells is too many, lower GRID_RES"
+#endif
+#define REFINE_ITER 10      // max iterations of the optional refinement over the raw data
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Weighted K-Means. This is the loop from K_means_para.c with one change: every point has a weight and contributes weight * point to the sums and weight to the counts.
+// weights == NULL means every point has weight 1, which is just normal K-Means (that is what the refinement pass uses).
+// since a representative is the mean of its cell, weight * representative is exactly the sum of the points in the cell, so the sums are exact per cell.
+// the assignment is per cell though: the whole cell goes to the centroid nearest to its representative, even if the cell straddles a Voronoi boundary
+// and some of its points are nearer to another centroid. so the result is an approximation, which is what the refinement pass on the full data fixes.
+// returns the number of iterations it ran
+
+int weighted_kmeans(double **points, const double *weights, int n, double centroids[K][DIM], label_t *labels, int max_iter) {
+    int iter;
+    int changed = 1;
+    for (iter = 0; iter < max_iter && changed; iter++) {
+        changed = 0;
+        double new_centroids[K][DIM] = {0};
+        double counts[K] = {0};     // sum of weights, not a number of points anymore
+
+        #pragma omp parallel reduction(|:changed)
+        {
+            double local_new_centroids[K][DIM] = {0};
+            double local_counts[K] = {0};
+
+            // assignment and summation are done in the same pass here since both only look at one point at a time
+            #pragma omp for nowait
+            for (int i = 0; i < n; i++) {
+                int best_cluster = 0;
+                double best_dist = distance_sq(points[i], centroids[0]);
+                for (int j = 1; j < K; j++) {
+                    double d = distance_sq(points[i], centroids[j]);
+                    if (d < best_dist) {
+                        best_dist = d;
+                        best_cluster = j;
+                    }
+                }
+                if (labels[i] != best_cluster) {
+                    labels[i] = (label_t)best_cluster;
+                    changed |= 1;
+                }
+                double w = weights ? weights[i] : 1.0;
+                local_counts[best_cluster] += w;
+                for (int d = 0; d < DIM; d++) {
+                    local_new_centroids[best_cluster][d] += w * points[i][d];
+                }
+            }
+
+            #pragma omp critical
+            {
+                for (int c = 0; c < K; c++) {
+                    counts[c] += local_counts[c];
+                    for (int d = 0; d < DIM; d++) {
+                        new_centroids[c][d] += local_new_centroids[c][d];
+                    }
+                }
+            }
+        }
+
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Grid pre-aggregation.
+
+struct grid {
+    double lo[DIM];         // bounding box of the data, the grid is laid over it
+    double cell_size[DIM];
+    int num_cells;          // GRID_CELLS
+    int num_occupied;
+    int *cell_to_rep;       // cell index -> representative index, -1 for empty cells
+    double *rep_storage;    // num_occupied * DIM doubles
+    double **reps;          // pointers into rep_storage so the reps look like data to weighted_kmeans
+    double *weights;        // number of points behind each representative
+};
+
+static int grid_cell_of(const struct grid *g, const double *point) {
+    int cell = 0;
+    for (int d = 0; d < DIM; d++) {
+        int c = (int)((point[d] - g->lo[d]) / g->cell_size[d]);
+        if (c >= GRID_RES) c = GRID_RES - 1;    // the max value of the box lands exactly on the upper edge
+        if (c < 0) c = 0;
+        cell = cell * GRID_RES + c;
+    }
+    return cell;
+}
+
+static struct grid *grid_build(double **data) {
+    struct grid *g = calloc(1, sizeof(*g));
+    double lo[DIM], hi[DIM];
+    for (int d = 0; d < DIM; d++) {
+        lo[d] = data[0][d];
+        hi[d] = data[0][d];
+    }
+    #pragma omp parallel for reduction(min:lo[:DIM]) reduction(max:hi[:DIM])
+    for (int i = 0; i < NUM_POINTS; i++) {
+        for (int d = 0; d < DIM; d++) {
+            if (data[i][d] < lo[d]) lo[d] = data[i][d];
+            if (data[i][d] > hi[d]) hi[d] = data[i][d];
+        }
+    }
+    g->num_cells = GRID_CELLS;
+    for (int d = 0; d < DIM; d++) {
+        g->lo[d] = lo[d];
+        g->cell_size[d] = hi[d] > lo[d] ? (hi[d] - lo[d]) / GRID_RES : 1.0;
+    }
+
+    // Every thread bins its share of the points into its own grid (same partial sum idea as the summation step), then the grids get added up cell by cell.
+    // the merge is parallel over the cells instead of a critical section since the grids are a lot bigger than K x DIM.
+    int num_threads = omp_get_max_threads();
+    double *cell_sums = calloc((size_t)num_threads * g->num_cells * DIM, sizeof(double));
+    int *cell_counts = calloc((size_t)num_threads * g->num_cells, sizeof(int));
+
+    #pragma omp parallel
+    {
+        int t = omp_get_thread_num();
+        double *my_sums = cell_sums + (size_t)t * g->num_cells * DIM;
+        int *my_counts = cell_counts + (size_t)t * g->num_cells;
+        #pragma omp for
+        for (int i = 0; i < NUM_POINTS; i++) {
+            int cell = grid_cell_of(g, data[i]);
+            my_counts[cell]++;
+            for (int d = 0; d < DIM; d++) {
+                my_sums[(size_t)cell * DIM + d] += data[i][d];
+            }
+        }
+
+        // thread 0's grid ends up holding the totals
+        #pragma omp for
+        for (int cell = 0; cell < g->num_cells; cell++) {
+            for (int other = 1; other < num_threads; other++) {
+                cell_counts[cell] += cell_counts[(size_t)other * g->num_cells + cell];
+                for (int d = 0; d < DIM; d++) {
+                    cell_sums[(size_t)cell * DIM + d] += cell_sums[((size_t)other * g->num_cells + cell) * DIM + d];
+                }
+            }
+        }
+    }
+
+    // number the occupied cells. this is a serial scan over the cells, which is fine because there are much fewer cells than points
+    g->cell_to_rep = malloc(g->num_cells * sizeof(int));
+    for (int cell = 0; cell < g->num_cells; cell++) {
+        g->cell_to_rep[cell] = cell_counts[cell] > 0 ? g->num_occupied++ : -1;
+    }
+    g->rep_storage = malloc((size_t)g->num_occupied * DIM * sizeof(double));
+    g->reps = malloc(g->num_occupied * sizeof(double *));
+    g->weights = malloc(g->num_occupied * sizeof(double));
+
+    #pragma omp parallel for
+    for (int cell = 0; cell < g->num_cells; cell++) {
+        int r = g->cell_to_rep[cell];
+        if (r < 0) continue;
+        g->reps[r] = g->rep_storage + (size_t)r * DIM;
+        g->weights[r] = cell_counts[cell];
+        for (int d = 0; d < DIM; d++) {
+            g->reps[r][d] = cell_sums[(size_t)cell * DIM + d] / cell_counts[cell];
+        }
+    }
+
+    free(cell_sums);
+    free(cell_counts);
+    return g;
+}
+
+static void grid_free(struct grid *g) {
+    free(g->cell_to_rep);
+    free(g->rep_storage);
+    free(g->reps);
+    free(g->weights);
+    free(g);
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+    int refine = argc > 1 && strcmp(argv[1], "refine") == 0;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));
+
+    double centroids[K][DIM];
+    for (i = 0; i < K; i++) {
+        for (j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Aggregate, cluster the representatives, hand the labels back to the raw points and optionally refine on the raw data.
+
+    double start_time = omp_get_wtime();
+
+    struct grid *g = grid_build(data);
+    double aggregate_time = omp_get_wtime() - start_time;
+
+    label_t *rep_labels = calloc(g->num_occupied, sizeof(label_t));
+    int iter = weighted_kmeans(g->reps, g->weights, g->num_occupied, centroids, rep_labels, MAX_ITER);
+
+    // every point gets the label of its cell
+    #pragma omp parallel for
+    for (i = 0; i < NUM_POINTS; i++) {
+        labels[i] = rep_labels[g->cell_to_rep[grid_cell_of(g, data[i])]];
+    }
+
+    int refine_iter = 0;
+    if (refine) {
+        refine_iter = weighted_kmeans(data, NULL, NUM_POINTS, centroids, labels, REFINE_ITER);
+    }
+
+    double end_time = omp_get_wtime();
+    double elapsed = end_time - start_time;
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("Grid: %d of %d cells occupied (aggregation took %f seconds)\n", g->num_occupied, g->num_cells, aggregate_time);
+    printf("K-Means converged in %d iterations over the cells", iter);
+    if (refine) printf(" + %d refinement iterations over the raw points", refine_iter);
+    printf(".\n");
+    printf("Elapsed time (weighted): %f seconds\n", elapsed);
+    printf("Final centroids:\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    grid_free(g);
+    free(rep_labels);
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+    free(labels);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
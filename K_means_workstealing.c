@@ -0,0 +1,478 @@
+// K-Means with a hand written work stealing thread pool (pthreads) as an alternative to OpenMP, benchmarked against the OpenMP static and dynamic schedules.
+// The static vs dynamic experiments (K_means_static.c / K_means_dynamic.c) showed how much the scheduling matters, and OpenMP is also hard to embed into a program
+// that already has its own threads. So here:
+//      - the pool is created once and its threads sleep on a condition variable between jobs (and at the end of a job when there is nothing left to steal),
+//        so they don't burn cpu while the host program runs
+//      - the thread that calls pool_parallel_for works as worker 0, so a pool of N workers only adds N - 1 threads (no oversubscription if N = cores we may use)
+//      - every worker has its own deque of index ranges. A worker takes the newest range from its own deque and splits it in half until it is small enough,
+//        pushing the other halves back. A worker whose deque is empty steals the oldest (biggest) range from another worker.
+// usage: ./K_means_workstealing <num_threads>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <omp.h>
+
+
+// ===================================================================================================================================
+
+// same as before
+
+#define NUM_POINTS 1000000   // A much larger dataset (adjust as needed)
+#define DIM 2               // 2D points (x and y)
+#define K 3                 // Number of clusters
+#define MAX_ITER 100        // Maximum iterations
+
+#define GRAIN 10000         // ranges are not split below this many points (same as the dynamic chunk size)
+#define DEQUE_CAP 64        // splitting in half keeps a deque short (about log2(NUM_POINTS / GRAIN) + 1 ranges), ws_push still checks it
+
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
+// Function to compute squared Euclidean distance between two points.
+double distance_sq(double p1[], double p2[]) {
+    double sum = 0.0;
+    for (int d = 0; d < DIM; d++) {
+        double diff = p1[d] - p2[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The kernel, shared by all the backends: assign the points [lo, hi) and add them to one worker's partial sums.
+
+struct partial_sums {
+    double sums[K][DIM];
+    int counts[K];
+    int changed;
+    char pad[64];   // keeps two workers' partials out of the same cache line
+};
+
+struct kmeans_state {
+    double **data;
+    label_t *labels;
+    double (*centroids)[DIM];
+    struct partial_sums *partials;  // one per worker / thread
+};
+
+static void assign_accumulate(struct kmeans_state *s, long lo, long hi, struct partial_sums *mine) {
+    for (long i = lo; i < hi; i++) {
+        int best_cluster = 0;
+        double best_dist = distance_sq(s->data[i], s->centroids[0]);
+        for (int j = 1; j < K; j++) {
+            double d = distance_sq(s->data[i], s->centroids[j]);
+            if (d < best_dist) {
+                best_dist = d;
+                best_cluster = j;
+            }
+        }
+        if (s->labels[i] != best_cluster) {
+            s->labels[i] = (label_t)best_cluster;
+            mine->changed = 1;
+        }
+        mine->counts[best_cluster]++;
+        for (int d = 0; d < DIM; d++) {
+            mine->sums[best_cluster][d] += s->data[i][d];
+        }
+    }
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// The work stealing pool.
+
+struct ws_range {
+    long lo, hi;
+};
+
+// each deque has its own small lock, the owner and the thieves only fight over it when someone is actually stealing
+struct ws_deque {
+    pthread_mutex_t lock;
+    struct ws_range items[DEQUE_CAP];
+    int top;        // thieves take from here (oldest range)
+    int bottom;     // the owner pushes and pops here (newest range)
+    char pad[64];
+};
+
+typedef void (*ws_range_fn)(long lo, long hi, int worker, void *ctx);
+
+struct ws_pool {
+    int num_workers;
+    pthread_t *threads;         // num_workers - 1 threads, worker 0 is whoever calls pool_parallel_for
+    struct ws_deque *deques;
+
+    pthread_mutex_t lock;       // protects generation / quit and is used for sleeping between jobs
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    long generation;            // bumped for every new job, that is how the sleeping workers know there is something to do
+    int quit;
+    int busy_workers;           // workers still inside the current job
+
+    // the current job
+    ws_range_fn fn;
+    void *ctx;
+    long grain;
+    atomic_long remaining;      // points that haven't been processed yet, the job is over when this hits 0
+
+    // idle workers sleep on wake (under lock) until somebody pushes a new range or the job is over, instead of spinning
+    atomic_long pushes;         // bumped on every ws_push
+    atomic_int idle_workers;    // workers sleeping inside the job, ws_push only takes the lock to wake them if there are any
+};
+
+// returns 0 if the deque is full, the caller then just runs the range itself
+static int ws_push(struct ws_pool *p, struct ws_deque *q, long lo, long hi) {
+    pthread_mutex_lock(&q->lock);
+    if (q->bottom == DEQUE_CAP && q->top > 0) {
+        // thieves took from the front, move what's left back to the start of the array
+        memmove(q->items, q->items + q->top, (q->bottom - q->top) * sizeof(struct ws_range));
+        q->bottom -= q->top;
+        q->top = 0;
+    }
+    if (q->bottom == DEQUE_CAP) {
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+    q->items[q->bottom].lo = lo;
+    q->items[q->bottom].hi = hi;
+    q->bottom++;
+    pthread_mutex_unlock(&q->lock);
+
+    atomic_fetch_add(&p->pushes, 1);
+    if (atomic_load(&p->idle_workers) > 0) {
+        pthread_mutex_lock(&p->lock);
+        pthread_cond_broadcast(&p->wake);
+        pthread_mutex_unlock(&p->lock);
+    }
+    return 1;
+}
+
+static int ws_pop(struct ws_deque *q, struct ws_range *out) {
+    int ok = 0;
+    pthread_mutex_lock(&q->lock);
+    if (q->bottom > q->top) {
+        *out = q->items[--q->bottom];
+        ok = 1;
+    }
+    if (q->bottom == q->top) q->bottom = q->top = 0;    // empty again, start from the beginning of the array
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+static int ws_steal(struct ws_deque *q, struct ws_range *out) {
+    int ok = 0;
+    pthread_mutex_lock(&q->lock);
+    if (q->bottom > q->top) {
+        *out = q->items[q->top++];
+        ok = 1;
+    }
+    if (q->bottom == q->top) q->bottom = q->top = 0;
+    pthread_mutex_unlock(&q->lock);
+    return ok;
+}
+
+// runs ranges until the whole job is done, stealing when our own deque runs dry
+static void ws_work(struct ws_pool *p, int me) {
+    struct ws_deque *mine = &p->deques[me];
+    unsigned int victim_seed = me * 7919 + 1;
+    struct ws_range r;
+
+    while (atomic_load_explicit(&p->remaining, memory_order_acquire) > 0) {
+        long pushes_seen = atomic_load(&p->pushes);
+        int found = ws_pop(mine, &r);
+        for (int tries = 0; !found && tries < 2 * p->num_workers; tries++) {
+            int victim = rand_r(&victim_seed) % p->num_workers;
+            if (victim != me) found = ws_steal(&p->deques[victim], &r);
+        }
+        // the random tries can miss the one deque that still has something, look at all of them once before going to sleep
+        for (int victim = 0; !found && victim < p->num_workers; victim++) {
+            if (victim != me) found = ws_steal(&p->deques[victim], &r);
+        }
+        if (!found) {
+            // the last ranges are being worked on by others. sleep until one of them splits off a new range or the job is done.
+            // idle_workers goes up before pushes is checked and ws_push bumps pushes before it checks idle_workers, so one of the two always sees the other
+            pthread_mutex_lock(&p->lock);
+            atomic_fetch_add(&p->idle_workers, 1);
+            while (atomic_load(&p->remaining) > 0 && atomic_load(&p->pushes) == pushes_seen) {
+                pthread_cond_wait(&p->wake, &p->lock);
+            }
+            atomic_fetch_sub(&p->idle_workers, 1);
+            pthread_mutex_unlock(&p->lock);
+            continue;
+        }
+        // split off the upper halves for others to steal until the range is small enough (or our deque is full), then run it
+        while (r.hi - r.lo > p->grain) {
+            long mid = r.lo + (r.hi - r.lo) / 2;
+            if (!ws_push(p, mine, mid, r.hi)) break;
+            r.hi = mid;
+        }
+        p->fn(r.lo, r.hi, me, p->ctx);
+        if (atomic_fetch_sub_explicit(&p->remaining, r.hi - r.lo, memory_order_release) == r.hi - r.lo) {
+            // that was the last range of the job, wake up whoever is sleeping above
+            pthread_mutex_lock(&p->lock);
+            pthread_cond_broadcast(&p->wake);
+            pthread_mutex_unlock(&p->lock);
+        }
+    }
+}
+
+static void *ws_worker_main(void *arg) {
+    struct ws_pool *p = ((void **)arg)[0];
+    int me = (int)(long)((void **)arg)[1];
+    free(arg);
+
+    long seen = 0;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (p->generation == seen && !p->quit) {
+            pthread_cond_wait(&p->wake, &p->lock);
+        }
+        if (p->quit) break;
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        ws_work(p, me);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busy_workers == 0) pthread_cond_signal(&p->done);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+static struct ws_pool *pool_create(int num_workers) {
+    struct ws_pool *p = calloc(1, sizeof(*p));
+    p->num_workers = num_workers;
+    p->deques = calloc(num_workers, sizeof(struct ws_deque));
+    p->threads = malloc(num_workers * sizeof(pthread_t));
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wake, NULL);
+    pthread_cond_init(&p->done, NULL);
+    atomic_init(&p->remaining, 0);
+    atomic_init(&p->pushes, 0);
+    atomic_init(&p->idle_workers, 0);
+    for (int w = 0; w < num_workers; w++) {
+        pthread_mutex_init(&p->deques[w].lock, NULL);
+    }
+    for (int w = 1; w < num_workers; w++) {
+        void **arg = malloc(2 * sizeof(void *));
+        arg[0] = p;
+        arg[1] = (void *)(long)w;
+        pthread_create(&p->threads[w], NULL, ws_worker_main, arg);
+    }
+    return p;
+}
+
+// runs fn over [0, n) on all workers and returns when everything is done. the range starts out split evenly (like a static schedule),
+// stealing only kicks in when some workers finish early
+static void pool_parallel_for(struct ws_pool *p, long n, long grain, ws_range_fn fn, void *ctx) {
+    p->fn = fn;
+    p->ctx = ctx;
+    p->grain = grain;
+    for (int w = 0; w < p->num_workers; w++) {
+        long lo = n * w / p->num_workers, hi = n * (w + 1) / p->num_workers;
+        if (hi > lo) ws_push(p, &p->deques[w], lo, hi);    // the deques are empty between jobs, this always fits
+    }
+    atomic_store_explicit(&p->remaining, n, memory_order_release);
+
+    pthread_mutex_lock(&p->lock);
+    p->busy_workers = p->num_workers - 1;
+    p->generation++;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+
+    ws_work(p, 0);
+
+    // remaining == 0 means all the points are done, but we still wait for the other workers to leave ws_work before the next job can reuse the deques
+    pthread_mutex_lock(&p->lock);
+    while (p->busy_workers > 0) {
+        pthread_cond_wait(&p->done, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void pool_destroy(struct ws_pool *p) {
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->wake);
+    pthread_mutex_unlock(&p->lock);
+    for (int w = 1; w < p->num_workers; w++) {
+        pthread_join(p->threads[w], NULL);
+    }
+    for (int w = 0; w < p->num_workers; w++) {
+        pthread_mutex_destroy(&p->deques[w].lock);
+    }
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->wake);
+    pthread_cond_destroy(&p->done);
+    free(p->deques);
+    free(p->threads);
+    free(p);
+}
+
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// One full K-Means run on a given backend. Everything except the way the points get split among the threads is the same for all of them.
+
+enum backend { BACKEND_POOL, BACKEND_OMP_STATIC, BACKEND_OMP_DYNAMIC };
+
+static void pool_kernel(long lo, long hi, int worker, void *ctx) {
+    struct kmeans_state *s = ctx;
+    assign_accumulate(s, lo, hi, &s->partials[worker]);
+}
+
+static int kmeans_run(enum backend backend, struct ws_pool *pool, int num_threads, double **data, double centroids[K][DIM], double *elapsed) {
+    struct kmeans_state s;
+    s.data = data;
+    s.labels = calloc(NUM_POINTS, sizeof(label_t));
+    s.centroids = centroids;
+    s.partials = malloc(num_threads * sizeof(struct partial_sums));
+    for (int i = 0; i < K; i++) {
+        for (int j = 0; j < DIM; j++) {
+            centroids[i][j] = data[i][j];
+        }
+    }
+
+    double start_time = omp_get_wtime();
+    int iter;
+    int changed = 1;
+    for (iter = 0; iter < MAX_ITER && changed; iter++) {
+        memset(s.partials, 0, num_threads * sizeof(struct partial_sums));
+
+        if (backend == BACKEND_POOL) {
+            pool_parallel_for(pool, NUM_POINTS, GRAIN, pool_kernel, &s);
+        } else if (backend == BACKEND_OMP_STATIC) {
+            #pragma omp parallel num_threads(num_threads)
+            {
+                struct partial_sums *mine = &s.partials[omp_get_thread_num()];
+                #pragma omp for schedule(static)
+                for (long c = 0; c < NUM_POINTS; c += GRAIN) {
+                    assign_accumulate(&s, c, c + GRAIN < NUM_POINTS ? c + GRAIN : NUM_POINTS, mine);
+                }
+            }
+        } else {
+            #pragma omp parallel num_threads(num_threads)
+            {
+                struct partial_sums *mine = &s.partials[omp_get_thread_num()];
+                #pragma omp for schedule(dynamic, 1)
+                for (long c = 0; c < NUM_POINTS; c += GRAIN) {
+                    assign_accumulate(&s, c, c + GRAIN < NUM_POINTS ? c + GRAIN : NUM_POINTS, mine);
+                }
+            }
+        }
+
+        double new_centroids[K][DIM] = {0};
+        int counts[K] = {0};
+        changed = 0;
+        for (int t = 0; t < num_threads; t++) {
+            changed |= s.partials[t].changed;
+            for (int c = 0; c < K; c++) {
+                counts[c] += s.partials[t].counts[c];
+                for (int d = 0; d < DIM; d++) {
+                    new_centroids[c][d] += s.partials[t].sums[c][d];
+                }
+            }
+        }
+        for (int c = 0; c < K; c++) {
+            if (counts[c] > 0) {
+                for (int d = 0; d < DIM; d++) {
+                    centroids[c][d] = new_centroids[c][d] / counts[c];
+                }
+            }
+        }
+    }
+    *elapsed = omp_get_wtime() - start_time;
+
+    free(s.labels);
+    free(s.partials);
+    return iter;
+}
+
+// ===================================================================================================================================
+
+
+
+int main(int argc, char *argv[]) {
+
+    int i, j;
+    int num_threads = argc > 1 ? atoi(argv[1]) : omp_get_max_threads();
+    if (num_threads < 1) num_threads = 1;
+
+// ===================================================================================================================================
+// Loading/creating the data, same as K_means_para.c
+
+    double **data = malloc(NUM_POINTS * sizeof(double *));
+    for (i = 0; i < NUM_POINTS; i++) {
+        data[i] = malloc(DIM * sizeof(double));
+    }
+
+    for (i = 0; i < NUM_POINTS; i++) {
+        for (j = 0; j < DIM; j++) {
+            data[i][j] = (double)rand() / RAND_MAX;
+        }
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+// Run the same clustering on every backend and compare.
+
+    const char *names[] = {"work stealing pool", "omp static", "omp dynamic"};
+    double centroids[3][K][DIM];
+    double elapsed[3];
+    int iters[3];
+
+    struct ws_pool *pool = pool_create(num_threads);
+    for (int b = 0; b < 3; b++) {
+        iters[b] = kmeans_run((enum backend)b, pool, num_threads, data, centroids[b], &elapsed[b]);
+    }
+    pool_destroy(pool);
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Print out the results.
+    printf("Threads: %d\n", num_threads);
+    for (int b = 0; b < 3; b++) {
+        printf("%-20s converged in %d iterations, elapsed time: %f seconds\n", names[b], iters[b], elapsed[b]);
+    }
+    printf("Final centroids (work stealing pool):\n");
+    for (i = 0; i < K; i++) {
+        printf("Cluster %d: ", i);
+        for (j = 0; j < DIM; j++) {
+            printf("%f ", centroids[0][i][j]);
+        }
+        printf("\n");
+    }
+// ===================================================================================================================================
+
+
+// ===================================================================================================================================
+
+    // Free allocated memory.
+    for (i = 0; i < NUM_POINTS; i++) {
+        free(data[i]);
+    }
+    free(data);
+
+    return 0;
+// ===================================================================================================================================
+
+
+}
@@ -12,6 +12,16 @@
 #define K 3                 // Number of clusters
 #define MAX_ITER 100        // Maximum iterations
 
+// labels only ever hold a value in [0, K), so instead of always spending a 4 byte int per point we pick the smallest type that fits K.
+// the labels array is read and written on every iteration so a smaller type means less memory traffic (1M points = 1MB instead of 4MB for K <= 256)
+#if K <= 256
+typedef unsigned char label_t;      // 1 byte per point
+#elif K <= 65536
+typedef unsigned short label_t;     // 2 bytes per point
+#else
+typedef int label_t;                // fall back to the old 4 byte labels
+#endif
+
 // Function to compute squared Euclidean distance between two points.
 double distance_sq(double p1[], double p2[]) {
     double sum = 0.0;
@@ -54,7 +64,7 @@ int main(int argc, char *argv[]) {
     }
     
     // Array for cluster assignments (labels) for each point.
-    int *labels = calloc(NUM_POINTS, sizeof(int));  // Initializes to 0.
+    label_t *labels = calloc(NUM_POINTS, sizeof(label_t));  // Initializes to 0.
     
     // Initialize centroids (K x DIM). We'll use the first K points as our initial centroids.
     double centroids[K][DIM];
@@ -97,7 +107,7 @@ int main(int argc, char *argv[]) {
                 }
             }
             if (labels[i] != best_cluster) {
-                labels[i] = best_cluster;
+                labels[i] = (label_t)best_cluster;
                 changed |= 1;
             }
         }